@@ -0,0 +1,146 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+
+//
+// Running totals kept by the Category 7 allocators.
+// Byte counts are only as accurate as the allocator's knowledge of block sizes,
+// HeapAllocator over HostMemory counts blocks but not bytes.
+//
+// Blocks reclaimed by a garbage collector count as deallocations
+// and are also tallied separately, along with the time spent collecting.
+//
+
+class AllocationStatistics
+{
+private:
+	std::size_t allocationCount = 0;
+	std::size_t deallocationCount = 0;
+	std::size_t allocatedBytes = 0;
+	std::size_t deallocatedBytes = 0;
+	std::size_t peakBytes = 0;
+
+	std::size_t collectionCount = 0;
+	std::size_t reclaimedCount = 0;
+	std::size_t reclaimedBytes = 0;
+	std::uint64_t collectionNanoseconds = 0;
+	std::uint64_t longestPauseNanoseconds = 0;
+
+public:
+	void recordAllocation(std::size_t size)
+	{
+		++this->allocationCount;
+		this->allocatedBytes += size;
+
+		const std::size_t liveBytes = this->getLiveBytes();
+		if (liveBytes > this->peakBytes)
+			this->peakBytes = liveBytes;
+	}
+
+	void recordDeallocation(std::size_t size)
+	{
+		++this->deallocationCount;
+		this->deallocatedBytes += size;
+	}
+
+	void recordCollection(void)
+	{
+		++this->collectionCount;
+	}
+
+	void recordReclamation(std::size_t size)
+	{
+		this->recordDeallocation(size);
+
+		++this->reclaimedCount;
+		this->reclaimedBytes += size;
+	}
+
+	// Called for each uninterrupted stretch of collection work
+	void recordPause(std::uint64_t nanoseconds)
+	{
+		this->collectionNanoseconds += nanoseconds;
+
+		if (nanoseconds > this->longestPauseNanoseconds)
+			this->longestPauseNanoseconds = nanoseconds;
+	}
+
+	std::size_t getAllocationCount(void) const
+	{
+		return this->allocationCount;
+	}
+
+	std::size_t getDeallocationCount(void) const
+	{
+		return this->deallocationCount;
+	}
+
+	std::size_t getAllocatedBytes(void) const
+	{
+		return this->allocatedBytes;
+	}
+
+	std::size_t getDeallocatedBytes(void) const
+	{
+		return this->deallocatedBytes;
+	}
+
+	// Blocks that are still allocated
+	std::size_t getLiveCount(void) const
+	{
+		return (this->allocationCount - this->deallocationCount);
+	}
+
+	std::size_t getLiveBytes(void) const
+	{
+		return (this->allocatedBytes - this->deallocatedBytes);
+	}
+
+	// The most bytes that have been live at once
+	std::size_t getPeakBytes(void) const
+	{
+		return this->peakBytes;
+	}
+
+	std::size_t getCollectionCount(void) const
+	{
+		return this->collectionCount;
+	}
+
+	std::size_t getReclaimedCount(void) const
+	{
+		return this->reclaimedCount;
+	}
+
+	std::size_t getReclaimedBytes(void) const
+	{
+		return this->reclaimedBytes;
+	}
+
+	// Total time spent collecting
+	std::uint64_t getCollectionNanoseconds(void) const
+	{
+		return this->collectionNanoseconds;
+	}
+
+	std::uint64_t getLongestPauseNanoseconds(void) const
+	{
+		return this->longestPauseNanoseconds;
+	}
+};
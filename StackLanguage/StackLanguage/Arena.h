@@ -0,0 +1,160 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+
+//
+// A bump-pointer region for short-lived allocations.
+//
+// Memory is taken from the allocator in chunks of at least ChunkSize bytes.
+// Each chunk starts with a header holding the address of the previous chunk and its own size.
+// Allocating is a pointer increment, and everything allocated is released at once
+// by reset or release, which cost one deallocation per chunk.
+//
+
+class Arena
+{
+public:
+	static constexpr Word ChunkSize = 4096;
+
+private:
+	static constexpr Word HeaderSize = (sizeof(Word) * 2);
+	static constexpr Word SizeMask = ~static_cast<Word>(sizeof(Word) - 1);
+
+private:
+	Address chunks = 0;
+	Address next = 0;
+	Address end = 0;
+	bool active = false;
+
+public:
+	bool isActive(void) const
+	{
+		return this->active;
+	}
+
+	void activate(void)
+	{
+		this->active = true;
+	}
+
+	// The newest chunk, older chunks are linked through their headers
+	Address getChunks(void) const
+	{
+		return this->chunks;
+	}
+
+	// Returns 0 on failure
+	template< typename Allocator, typename Memory >
+	Address allocate(Allocator & allocator, Memory & memory, Word size);
+
+	// Releases every chunk but the first, and rewinds to its start
+	template< typename Allocator, typename Memory >
+	void reset(Allocator & allocator, Memory & memory);
+
+	// Releases every chunk and deactivates the arena
+	template< typename Allocator, typename Memory >
+	void release(Allocator & allocator, Memory & memory);
+};
+
+//
+// Definition
+//
+
+template< typename Allocator, typename Memory >
+Address Arena::allocate(Allocator & allocator, Memory & memory, Word size)
+{
+	if (size > (~static_cast<Word>(0) - HeaderSize - sizeof(Word)))
+		return 0;
+
+	const Word blockSize = ((size + (sizeof(Word) - 1)) & SizeMask);
+
+	if (blockSize <= (this->end - this->next))
+	{
+		const Address result = this->next;
+		this->next += blockSize;
+		return result;
+	}
+
+	const Word chunkSize = ((blockSize + HeaderSize) > ChunkSize) ? (blockSize + HeaderSize) : ChunkSize;
+	const Address chunk = allocator.allocate(memory, chunkSize);
+
+	if (chunk == 0)
+		return 0;
+
+	memory.storeWord(chunk, this->chunks);
+	memory.storeWord(chunk + sizeof(Word), chunkSize);
+
+	this->chunks = chunk;
+	this->next = (chunk + HeaderSize + blockSize);
+	this->end = (chunk + chunkSize);
+
+	return (chunk + HeaderSize);
+}
+
+template< typename Allocator, typename Memory >
+void Arena::reset(Allocator & allocator, Memory & memory)
+{
+	Address chunk = this->chunks;
+
+	if (chunk == 0)
+		return;
+
+	for (Word previous; memory.loadWord(chunk, previous) && (previous != 0); chunk = previous)
+		if (!allocator.deallocate(memory, chunk))
+		{
+			// The program has overwritten a chunk header, so abandon the chain
+			this->chunks = 0;
+			this->next = 0;
+			this->end = 0;
+			return;
+		}
+
+	Word chunkSize;
+	if (!memory.loadWord(chunk + sizeof(Word), chunkSize))
+		chunkSize = HeaderSize;
+
+	this->chunks = chunk;
+	this->next = (chunk + HeaderSize);
+	this->end = (chunk + chunkSize);
+}
+
+template< typename Allocator, typename Memory >
+void Arena::release(Allocator & allocator, Memory & memory)
+{
+	Address chunk = this->chunks;
+
+	while (chunk != 0)
+	{
+		Word previous;
+		if (!memory.loadWord(chunk, previous))
+			previous = 0;
+
+		// Stop if the program has overwritten a chunk header
+		if (!allocator.deallocate(memory, chunk))
+			break;
+
+		chunk = previous;
+	}
+
+	this->chunks = 0;
+	this->next = 0;
+	this->end = 0;
+	this->active = false;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+
+//
+// A read-only window onto items that live somewhere else, such as a mapped file.
+// Copying a view never copies the items, so the owner must outlive every view of them.
+//
+
+template< typename Type >
+class ArrayView
+{
+public:
+	using ValueType = Type;
+	using SizeType = std::size_t;
+	using IndexType = std::size_t;
+
+private:
+	const ValueType * items = nullptr;
+	SizeType count = 0;
+
+public:
+	constexpr ArrayView(void) = default;
+
+	constexpr ArrayView(const ValueType * items, SizeType count)
+		: items(items), count(count)
+	{
+	}
+
+	// O(1)
+	constexpr bool isEmpty(void) const noexcept
+	{
+		return (this->count == 0);
+	}
+
+	// O(1)
+	constexpr SizeType getCount(void) const noexcept
+	{
+		return this->count;
+	}
+
+	// O(1)
+	constexpr const ValueType * getData(void) const noexcept
+	{
+		return this->items;
+	}
+
+	// O(1)
+	constexpr const ValueType & operator [](IndexType index) const
+	{
+		return this->items[index];
+	}
+};
@@ -0,0 +1,792 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Opcode.h"
+#include "Instruction.h"
+#include "Module.h"
+#include "ModuleBuilder.h"
+#include "ResultInfo.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// Turns assembly source into a module in a single pass.
+//
+// Each line holds an optional label, then an instruction or directive, then an optional comment:
+//
+//   loop:   Push 'A'        ; Comments start with a semicolon
+//           PrintChar
+//           JumpRelative loop
+//
+// Mnemonics are the names of the Opcodes, in any case.
+// An instruction's operand is optional and defaults to 0. It can be a number (decimal,
+// 0x hexadecimal or 0b binary, optionally negative), a character such as 'A' or '\n', or a name.
+// Operands too wide for an instruction are given an Extend prefix.
+//
+// Labels in code stand for the index of the next instruction, and JumpRelative to a code label
+// jumps to it. Labels in data stand for the address of the next byte once loaded.
+// Names can be used before they're defined. Each such use is recorded in a backpatch list
+// and filled in at the end, so a forward reference can't be given an Extend prefix.
+//
+// Directives
+//
+//   .code                    Following lines add to the code section, the default
+//   .data                    Following lines add to the data section
+//   .entry name              Starts the program at a code label rather than the first instruction
+//   .define name value       Names a value, which must be known already
+//   .constant name value     Adds a word to the constant pool, name is its index for PushConstant
+//   .byte value, ...         Adds bytes to the data section
+//   .word value, ...         Adds words to the data section
+//   .string "text"           Adds text and a terminating zero to the data section
+//   .space count             Adds count zero bytes to the data section
+//   .align size              Pads the data section to a multiple of size
+//
+// Code, data and constant labels are written to the module's symbol table.
+//
+
+class Assembler
+{
+private:
+	enum class SymbolKind : std::uint8_t
+	{
+		Undefined,
+		Code,
+		Data,
+		Constant,
+		Value,
+	};
+
+	struct Symbol
+	{
+		std::string name;
+		SymbolKind kind;
+		Word value;
+	};
+
+	// A value that may still be waiting for its symbol
+	struct Operand
+	{
+		Word value;
+		SymbolKind kind;
+		std::size_t symbol;
+	};
+
+	enum class PatchKind : std::uint8_t
+	{
+		Operand,
+		DataByte,
+		DataWord,
+		Constant,
+	};
+
+	struct Patch
+	{
+		PatchKind kind;
+		std::size_t position;
+		std::size_t symbol;
+		std::size_t line;
+	};
+
+	static constexpr std::size_t NoSymbol = static_cast<std::size_t>(~0);
+
+private:
+	ModuleBuilder * builder = nullptr;
+
+	std::vector<Symbol> symbols;
+	std::unordered_map<std::string, std::size_t> symbolIndices;
+	std::vector<Patch> patches;
+
+	std::size_t entrySymbol = NoSymbol;
+	bool inData = false;
+
+	const char * position = nullptr;
+	const char * end = nullptr;
+	std::size_t line = 0;
+	std::size_t errorLine = 0;
+
+public:
+	// Adds the assembled program to builder.
+	// On error, getErrorLine gives the line at fault.
+	ResultInfo assemble(const char * source, std::size_t size, ModuleBuilder & builder);
+
+	// Lines are counted from 1
+	std::size_t getErrorLine(void) const
+	{
+		return this->errorLine;
+	}
+
+private:
+	ResultInfo error(const char * message)
+	{
+		this->errorLine = this->line;
+		return resultError(message);
+	}
+
+	ResultInfo assembleLine(void);
+	ResultInfo assembleInstruction(Opcode opcode);
+	ResultInfo assembleDirective(const char * name, std::size_t length);
+	ResultInfo assembleValues(PatchKind kind);
+	ResultInfo assembleString(void);
+	ResultInfo resolvePatches(void);
+
+	ResultInfo defineSymbol(const char * name, std::size_t length, SymbolKind kind, Word value);
+	std::size_t findSymbol(const char * name, std::size_t length);
+
+	ResultInfo parseOperand(Operand & operand);
+	ResultInfo parseNumber(Word & value);
+	ResultInfo parseCharacter(char & character);
+
+	// Writes value where patch points, or where a new value of that kind goes
+	ResultInfo placeValue(PatchKind kind, std::size_t position, const Operand & operand);
+
+	static bool isExtendable(Opcode opcode)
+	{
+		switch (opcode)
+		{
+		case Opcode::Push:
+		case Opcode::Call:
+		case Opcode::JumpRelative:
+		case Opcode::JumpAbsolute:
+		case Opcode::AddImmediate:
+		case Opcode::SubtractImmediate:
+		case Opcode::AndImmediate:
+		case Opcode::OrImmediate:
+		case Opcode::ExclusiveOrImmediate:
+			return true;
+
+		default:
+			return false;
+		}
+	}
+
+	static bool findMnemonic(const char * name, std::size_t length, Opcode & opcode);
+
+	//
+	// Scanning
+	//
+
+	static bool isIdentifierStart(char character)
+	{
+		return ((character >= 'a') && (character <= 'z')) || ((character >= 'A') && (character <= 'Z')) || (character == '_');
+	}
+
+	static bool isIdentifierPart(char character)
+	{
+		return isIdentifierStart(character) || ((character >= '0') && (character <= '9'));
+	}
+
+	void skipSpaces(void)
+	{
+		while ((this->position != this->end) && ((*this->position == ' ') || (*this->position == '\t') || (*this->position == '\r')))
+			++this->position;
+	}
+
+	bool isEndOfStatement(void) const
+	{
+		return (this->position == this->end) || (*this->position == '\n') || (*this->position == ';');
+	}
+
+	bool accept(char character)
+	{
+		if ((this->position == this->end) || (*this->position != character))
+			return false;
+
+		++this->position;
+		return true;
+	}
+
+	std::size_t readIdentifier(void)
+	{
+		const char * start = this->position;
+
+		if ((this->position != this->end) && isIdentifierStart(*this->position))
+			while ((this->position != this->end) && isIdentifierPart(*this->position))
+				++this->position;
+
+		return static_cast<std::size_t>(this->position - start);
+	}
+};
+
+//
+// Definition
+//
+
+inline ResultInfo Assembler::assemble(const char * source, std::size_t size, ModuleBuilder & builder)
+{
+	*this = Assembler();
+
+	this->builder = &builder;
+	this->position = source;
+	this->end = (source + size);
+	this->line = 1;
+
+	while (this->position != this->end)
+	{
+		const ResultInfo result = this->assembleLine();
+
+		if (result.isError())
+			return result;
+
+		// Skip the comment and the line break
+		while ((this->position != this->end) && (*this->position != '\n'))
+			++this->position;
+
+		if (this->position != this->end)
+		{
+			++this->position;
+			++this->line;
+		}
+	}
+
+	const ResultInfo result = this->resolvePatches();
+
+	if (result.isError())
+		return result;
+
+	for (const Symbol & symbol : this->symbols)
+		switch (symbol.kind)
+		{
+		case SymbolKind::Code: builder.addSymbol(symbol.name.data(), symbol.name.size(), ModuleSectionType::Code, symbol.value); break;
+		case SymbolKind::Data: builder.addSymbol(symbol.name.data(), symbol.name.size(), ModuleSectionType::Data, symbol.value); break;
+		case SymbolKind::Constant: builder.addSymbol(symbol.name.data(), symbol.name.size(), ModuleSectionType::Constants, symbol.value); break;
+		default: break;
+		}
+
+	this->builder = nullptr;
+
+	return resultSuccess();
+}
+
+inline ResultInfo Assembler::assembleLine(void)
+{
+	this->skipSpaces();
+
+	if (this->isEndOfStatement())
+		return resultSuccess();
+
+	const bool isDirective = this->accept('.');
+	const char * name = this->position;
+	const std::size_t length = this->readIdentifier();
+
+	if (length == 0)
+		return this->error("Expected an instruction, directive or label");
+
+	if (isDirective)
+		return this->assembleDirective(name, length);
+
+	// Label
+	if (this->accept(':'))
+	{
+		const ResultInfo result = this->inData ?
+			this->defineSymbol(name, length, SymbolKind::Data, static_cast<Word>(Module::DataAddress + this->builder->getData().size())) :
+			this->defineSymbol(name, length, SymbolKind::Code, static_cast<Word>(this->builder->getCode().size()));
+
+		if (result.isError())
+			return result;
+
+		return this->assembleLine();
+	}
+
+	Opcode opcode;
+
+	if (!findMnemonic(name, length, opcode))
+		return this->error("Unrecognised mnemonic");
+
+	if (this->inData)
+		return this->error("Instructions belong in the code section");
+
+	return this->assembleInstruction(opcode);
+}
+
+inline ResultInfo Assembler::assembleInstruction(Opcode opcode)
+{
+	this->skipSpaces();
+
+	Operand operand = { 0, SymbolKind::Value, NoSymbol };
+
+	if (!this->isEndOfStatement())
+	{
+		const ResultInfo result = this->parseOperand(operand);
+
+		if (result.isError())
+			return result;
+
+		this->skipSpaces();
+
+		if (!this->isEndOfStatement())
+			return this->error("Expected the end of the line");
+	}
+
+	auto & code = this->builder->getCode();
+
+	code.push_back(Instruction(opcode));
+
+	return this->placeValue(PatchKind::Operand, code.size() - 1, operand);
+}
+
+inline ResultInfo Assembler::placeValue(PatchKind kind, std::size_t position, const Operand & operand)
+{
+	if (operand.kind == SymbolKind::Undefined)
+	{
+		this->patches.push_back(Patch { kind, position, operand.symbol, this->line });
+		return resultSuccess();
+	}
+
+	Word value = operand.value;
+
+	switch (kind)
+	{
+	case PatchKind::Operand:
+	{
+		auto & code = this->builder->getCode();
+		const Opcode opcode = code[position].getOpcode();
+		const bool isRelative = (opcode == Opcode::JumpRelative);
+
+		if (isRelative && (operand.kind == SymbolKind::Code))
+			value -= static_cast<Word>(position + 1);
+
+		const bool isInRange = isRelative ? Instruction::isSignedOperandInRange(static_cast<SWord>(value)) : Instruction::isOperandInRange(value);
+
+		if (!isInRange)
+		{
+			// Only the newest instruction can still be given a prefix
+			if ((position != (code.size() - 1)) || !isExtendable(opcode))
+				return this->error("Operand out of range");
+
+			// The prefix moves the jump along by one
+			if (isRelative && (operand.kind == SymbolKind::Code))
+				value -= 1;
+
+			code.insert(code.end() - 1, Instruction(Opcode::Extend, Instruction::getExtensionOperand(value)));
+			++position;
+		}
+
+		code[position] = Instruction(opcode, value);
+		return resultSuccess();
+	}
+
+	case PatchKind::DataByte:
+		if ((value > 0xFF) && ((static_cast<SWord>(value) < -0x80) || (static_cast<SWord>(value) >= 0)))
+			return this->error("Byte out of range");
+
+		this->builder->getData()[position] = static_cast<Byte>(value);
+		return resultSuccess();
+
+	case PatchKind::DataWord:
+		std::memcpy(&this->builder->getData()[position], &value, sizeof(Word));
+		return resultSuccess();
+
+	case PatchKind::Constant:
+		this->builder->getConstants()[position] = value;
+		return resultSuccess();
+	}
+
+	return this->error("Unrecognised value");
+}
+
+inline ResultInfo Assembler::assembleDirective(const char * name, std::size_t length)
+{
+	const std::string directive(name, length);
+
+	this->skipSpaces();
+
+	if (directive == "code")
+	{
+		this->inData = false;
+		return resultSuccess();
+	}
+
+	if (directive == "data")
+	{
+		this->inData = true;
+		return resultSuccess();
+	}
+
+	if ((directive == "entry") || (directive == "define") || (directive == "constant"))
+	{
+		const char * symbolName = this->position;
+		const std::size_t symbolLength = this->readIdentifier();
+
+		if (symbolLength == 0)
+			return this->error("Expected a name");
+
+		if (directive == "entry")
+		{
+			this->entrySymbol = this->findSymbol(symbolName, symbolLength);
+			return resultSuccess();
+		}
+
+		this->skipSpaces();
+
+		Operand operand;
+		const ResultInfo result = this->parseOperand(operand);
+
+		if (result.isError())
+			return result;
+
+		if (directive == "define")
+		{
+			if (operand.kind == SymbolKind::Undefined)
+				return this->error("Defined values must be known already");
+
+			return this->defineSymbol(symbolName, symbolLength, SymbolKind::Value, operand.value);
+		}
+
+		auto & constants = this->builder->getConstants();
+
+		const ResultInfo defineResult = this->defineSymbol(symbolName, symbolLength, SymbolKind::Constant, static_cast<Word>(constants.size()));
+
+		if (defineResult.isError())
+			return defineResult;
+
+		constants.push_back(0);
+
+		return this->placeValue(PatchKind::Constant, constants.size() - 1, operand);
+	}
+
+	if (!this->inData)
+		return this->error("Data directives belong in the data section");
+
+	if (directive == "byte")
+		return this->assembleValues(PatchKind::DataByte);
+
+	if (directive == "word")
+		return this->assembleValues(PatchKind::DataWord);
+
+	if (directive == "string")
+		return this->assembleString();
+
+	if ((directive == "space") || (directive == "align"))
+	{
+		Word value;
+		const ResultInfo result = this->parseNumber(value);
+
+		if (result.isError())
+			return result;
+
+		auto & data = this->builder->getData();
+
+		if (directive == "space")
+		{
+			data.resize(data.size() + value, 0);
+		}
+		else if (value > 0)
+		{
+			// Aligned once loaded
+			const std::size_t address = (Module::DataAddress + data.size());
+			data.resize(data.size() + ((value - (address % value)) % value), 0);
+		}
+
+		return resultSuccess();
+	}
+
+	return this->error("Unrecognised directive");
+}
+
+inline ResultInfo Assembler::assembleValues(PatchKind kind)
+{
+	auto & data = this->builder->getData();
+	const std::size_t size = (kind == PatchKind::DataWord) ? sizeof(Word) : sizeof(Byte);
+
+	do
+	{
+		this->skipSpaces();
+
+		Operand operand;
+		const ResultInfo result = this->parseOperand(operand);
+
+		if (result.isError())
+			return result;
+
+		data.resize(data.size() + size, 0);
+
+		if (kind == PatchKind::DataWord)
+			this->builder->getDataWords().push_back(static_cast<std::uint32_t>(data.size() - size));
+
+		const ResultInfo placeResult = this->placeValue(kind, data.size() - size, operand);
+
+		if (placeResult.isError())
+			return placeResult;
+
+		this->skipSpaces();
+	}
+	while (this->accept(','));
+
+	return resultSuccess();
+}
+
+inline ResultInfo Assembler::assembleString(void)
+{
+	if (!this->accept('"'))
+		return this->error("Expected a string");
+
+	auto & data = this->builder->getData();
+
+	while (!this->accept('"'))
+	{
+		if ((this->position == this->end) || (*this->position == '\n'))
+			return this->error("Unterminated string");
+
+		char character;
+		const ResultInfo result = this->parseCharacter(character);
+
+		if (result.isError())
+			return result;
+
+		data.push_back(static_cast<Byte>(character));
+	}
+
+	data.push_back(0);
+
+	return resultSuccess();
+}
+
+inline ResultInfo Assembler::resolvePatches(void)
+{
+	for (const Patch & patch : this->patches)
+	{
+		const Symbol & symbol = this->symbols[patch.symbol];
+
+		this->line = patch.line;
+
+		if (symbol.kind == SymbolKind::Undefined)
+			return this->error("Undefined name");
+
+		const ResultInfo result = this->placeValue(patch.kind, patch.position, Operand { symbol.value, symbol.kind, patch.symbol });
+
+		if (result.isError())
+			return result;
+	}
+
+	if (this->entrySymbol != NoSymbol)
+	{
+		const Symbol & symbol = this->symbols[this->entrySymbol];
+
+		if (symbol.kind != SymbolKind::Code)
+			return this->error("The entry point must be a code label");
+
+		this->builder->setEntryPoint(symbol.value);
+	}
+
+	return resultSuccess();
+}
+
+inline ResultInfo Assembler::defineSymbol(const char * name, std::size_t length, SymbolKind kind, Word value)
+{
+	Symbol & symbol = this->symbols[this->findSymbol(name, length)];
+
+	if (symbol.kind != SymbolKind::Undefined)
+		return this->error("Name defined twice");
+
+	symbol.kind = kind;
+	symbol.value = value;
+
+	return resultSuccess();
+}
+
+// Adds an undefined symbol if there isn't one called name
+inline std::size_t Assembler::findSymbol(const char * name, std::size_t length)
+{
+	std::string key(name, length);
+
+	const auto iterator = this->symbolIndices.find(key);
+
+	if (iterator != this->symbolIndices.end())
+		return iterator->second;
+
+	const std::size_t index = this->symbols.size();
+
+	this->symbols.push_back(Symbol { key, SymbolKind::Undefined, 0 });
+	this->symbolIndices.emplace(std::move(key), index);
+
+	return index;
+}
+
+inline ResultInfo Assembler::parseOperand(Operand & operand)
+{
+	if ((this->position != this->end) && isIdentifierStart(*this->position))
+	{
+		const char * name = this->position;
+		const std::size_t length = this->readIdentifier();
+		const std::size_t index = this->findSymbol(name, length);
+		const Symbol & symbol = this->symbols[index];
+
+		operand = Operand { symbol.value, symbol.kind, index };
+		return resultSuccess();
+	}
+
+	operand = Operand { 0, SymbolKind::Value, NoSymbol };
+
+	if (this->accept('\''))
+	{
+		char character;
+		const ResultInfo result = this->parseCharacter(character);
+
+		if (result.isError())
+			return result;
+
+		if (!this->accept('\''))
+			return this->error("Expected a closing quote");
+
+		operand.value = static_cast<Byte>(character);
+		return resultSuccess();
+	}
+
+	return this->parseNumber(operand.value);
+}
+
+inline ResultInfo Assembler::parseNumber(Word & value)
+{
+	const bool isNegative = this->accept('-');
+
+	Word base = 10;
+
+	if (((this->end - this->position) > 2) && (this->position[0] == '0'))
+	{
+		if ((this->position[1] == 'x') || (this->position[1] == 'X'))
+			base = 16;
+		else if ((this->position[1] == 'b') || (this->position[1] == 'B'))
+			base = 2;
+
+		if (base != 10)
+			this->position += 2;
+	}
+
+	std::uint64_t result = 0;
+	std::size_t digits = 0;
+
+	for (; this->position != this->end; ++this->position, ++digits)
+	{
+		const char character = *this->position;
+		Word digit;
+
+		if ((character >= '0') && (character <= '9'))
+			digit = static_cast<Word>(character - '0');
+		else if ((character >= 'a') && (character <= 'f'))
+			digit = static_cast<Word>(character - 'a' + 10);
+		else if ((character >= 'A') && (character <= 'F'))
+			digit = static_cast<Word>(character - 'A' + 10);
+		else
+			break;
+
+		if (digit >= base)
+			return this->error("Invalid digit");
+
+		result = ((result * base) + digit);
+
+		if (result > 0xFFFFFFFFu)
+			return this->error("Number out of range");
+	}
+
+	if (digits == 0)
+		return this->error("Expected a value");
+
+	value = isNegative ? static_cast<Word>(0u - static_cast<Word>(result)) : static_cast<Word>(result);
+	return resultSuccess();
+}
+
+inline ResultInfo Assembler::parseCharacter(char & character)
+{
+	if (this->position == this->end)
+		return this->error("Expected a character");
+
+	character = *this->position++;
+
+	if (character != '\\')
+		return resultSuccess();
+
+	if (this->position == this->end)
+		return this->error("Expected a character");
+
+	switch (*this->position++)
+	{
+	case 'n': character = '\n'; break;
+	case 't': character = '\t'; break;
+	case 'r': character = '\r'; break;
+	case '0': character = '\0'; break;
+	case '\\': character = '\\'; break;
+	case '\'': character = '\''; break;
+	case '"': character = '"'; break;
+	default: return this->error("Unrecognised escape sequence");
+	}
+
+	return resultSuccess();
+}
+
+inline bool Assembler::findMnemonic(const char * name, std::size_t length, Opcode & opcode)
+{
+	static const std::unordered_map<std::string, Opcode> mnemonics =
+	{
+		// Category 0 - Basic control
+		{ "nop", Opcode::Nop }, { "end", Opcode::End }, { "break", Opcode::Break },
+		{ "printint", Opcode::PrintInt }, { "printchar", Opcode::PrintChar }, { "printline", Opcode::PrintLine },
+		{ "printstack", Opcode::PrintStack }, { "extend", Opcode::Extend },
+
+		// Category 1 - Stack Manipulation
+		{ "push", Opcode::Push }, { "drop", Opcode::Drop }, { "pick", Opcode::Pick }, { "roll", Opcode::Roll },
+		{ "duplicate", Opcode::Duplicate }, { "swap", Opcode::Swap }, { "rotate", Opcode::Rotate }, { "over", Opcode::Over },
+		{ "pushconstant", Opcode::PushConstant },
+
+		// Category 2 - Flow Control
+		{ "call", Opcode::Call }, { "callindirect", Opcode::CallIndirect }, { "return", Opcode::Return },
+		{ "jumprelative", Opcode::JumpRelative }, { "jumpabsolute", Opcode::JumpAbsolute }, { "callnative", Opcode::CallNative },
+
+		// Category 3 - Arithmetic
+		{ "add", Opcode::Add }, { "addimmediate", Opcode::AddImmediate }, { "subtract", Opcode::Subtract },
+		{ "subtractimmediate", Opcode::SubtractImmediate }, { "negate", Opcode::Negate },
+
+		// Category 4 - Bitwise operations
+		{ "and", Opcode::And }, { "andimmediate", Opcode::AndImmediate }, { "or", Opcode::Or }, { "orimmediate", Opcode::OrImmediate },
+		{ "exclusiveor", Opcode::ExclusiveOr }, { "exclusiveorimmediate", Opcode::ExclusiveOrImmediate },
+		{ "shiftleft", Opcode::ShiftLeft }, { "shiftleftimmediate", Opcode::ShiftLeftImmediate },
+		{ "shiftright", Opcode::ShiftRight }, { "shiftrightimmediate", Opcode::ShiftRightImmediate }, { "not", Opcode::Not },
+
+		// Category 5 - Bit operations
+		{ "bitset", Opcode::BitSet }, { "bitclear", Opcode::BitClear }, { "bittoggle", Opcode::BitToggle },
+
+		// Category 6 - Load/Store
+		{ "loadbyte", Opcode::LoadByte }, { "loadword", Opcode::LoadWord }, { "storebyte", Opcode::StoreByte }, { "storeword", Opcode::StoreWord },
+		{ "storebyteimmediate", Opcode::StoreByteImmediate }, { "storewordimmediate", Opcode::StoreWordImmediate },
+
+		// Category 7 - Dynamic allocation
+		{ "malloc", Opcode::Malloc }, { "mallocimmediate", Opcode::MallocImmediate }, { "calloc", Opcode::Calloc },
+		{ "callocimmediate", Opcode::CallocImmediate }, { "realloc", Opcode::Realloc }, { "reallocimmediate", Opcode::ReallocImmediate },
+		{ "free", Opcode::Free }, { "arenacreate", Opcode::ArenaCreate }, { "arenaalloc", Opcode::ArenaAlloc },
+		{ "arenareset", Opcode::ArenaReset }, { "arenadestroy", Opcode::ArenaDestroy },
+	};
+
+	std::string key(name, length);
+
+	for (char & character : key)
+		if ((character >= 'A') && (character <= 'Z'))
+			character = static_cast<char>(character - 'A' + 'a');
+
+	const auto iterator = mnemonics.find(key);
+
+	if (iterator == mnemonics.end())
+		return false;
+
+	opcode = iterator->second;
+	return true;
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Instruction.h"
+#include "InstructionStore.h"
+#include "CompactCode.h"
+#include "Environment.h"
+#include "Processor.h"
+#include "Deque.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+//
+// Rough timings for choosing between implementations, run with "StackLanguage benchmark".
+//
+// Each figure is the best of several runs, which keeps out most of the noise
+// from other processes but not differences between machines,
+// so only figures from the same run should be compared.
+//
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+inline double getNanosecondsSince(BenchmarkClock::time_point start)
+{
+	return std::chrono::duration<double, std::nano>(BenchmarkClock::now() - start).count();
+}
+
+//
+// Deque Benchmark
+//
+
+// The array that Deque used to be: the first item is always at index 0,
+// so prepending and unprepending shift every item along by one
+template< typename Type, std::size_t Capacity >
+class ArrayShiftDeque
+{
+private:
+	Type items[Capacity] = {};
+	std::size_t count = 0;
+
+public:
+	// O(1)
+	bool append(const Type & item)
+	{
+		if (this->count >= Capacity)
+			return false;
+
+		this->items[this->count] = item;
+		++this->count;
+		return true;
+	}
+
+	// O(N)
+	bool prepend(const Type & item)
+	{
+		if (this->count >= Capacity)
+			return false;
+
+		for (std::size_t index = this->count; index > 0; --index)
+			this->items[index] = std::move(this->items[index - 1]);
+
+		this->items[0] = item;
+		++this->count;
+		return true;
+	}
+
+	// O(N)
+	void unprepend(void)
+	{
+		if (this->count == 0)
+			return;
+
+		--this->count;
+
+		for (std::size_t index = 0; index < this->count; ++index)
+			this->items[index] = std::move(this->items[index + 1]);
+	}
+
+	// O(1)
+	const Type & getFirst(void) const
+	{
+		return this->items[0];
+	}
+
+	// O(1)
+	const Type & getLast(void) const
+	{
+		return this->items[this->count - 1];
+	}
+
+	// O(1)
+	void clear(void)
+	{
+		this->count = 0;
+	}
+};
+
+// The best nanoseconds per operation of each of prepend, unprepend and append,
+// each timed filling or emptying a whole deque
+struct DequeTimes
+{
+	double prepend;
+	double unprepend;
+	double append;
+};
+
+template< typename DequeType, std::size_t Capacity >
+DequeTimes timeDeque(std::size_t runs)
+{
+	// Large enough for a few kilobytes, static to keep it off the stack
+	static DequeType deque;
+
+	DequeTimes best = { -1, -1, -1 };
+	volatile std::uint32_t sink = 0;
+
+	const auto keepBest = [](double & best, double time)
+	{
+		const double perOperation = (time / Capacity);
+
+		if ((best < 0) || (perOperation < best))
+			best = perOperation;
+	};
+
+	for (std::size_t run = 0; run < runs; ++run)
+	{
+		auto start = BenchmarkClock::now();
+
+		for (std::size_t index = 0; index < Capacity; ++index)
+			deque.prepend(static_cast<std::uint32_t>(index));
+
+		keepBest(best.prepend, getNanosecondsSince(start));
+		sink = (sink + deque.getFirst());
+
+		start = BenchmarkClock::now();
+
+		for (std::size_t index = 0; index < Capacity; ++index)
+			deque.unprepend();
+
+		keepBest(best.unprepend, getNanosecondsSince(start));
+
+		start = BenchmarkClock::now();
+
+		for (std::size_t index = 0; index < Capacity; ++index)
+			deque.append(static_cast<std::uint32_t>(index));
+
+		keepBest(best.append, getNanosecondsSince(start));
+		sink = (sink + deque.getLast());
+
+		deque.clear();
+	}
+
+	return best;
+}
+
+template< std::size_t Capacity >
+void benchmarkDequeCapacity(std::ostream & output)
+{
+	// Shifting is O(N) per item, so large capacities get fewer runs
+	const std::size_t runs = ((1u << 20) / Capacity);
+
+	const DequeTimes shift = timeDeque<ArrayShiftDeque<std::uint32_t, Capacity>, Capacity>(runs);
+	const DequeTimes circular = timeDeque<Deque<std::uint32_t, Capacity>, Capacity>(runs);
+
+	output << "  " << Capacity << " items: ";
+	output << "prepend " << shift.prepend << " -> " << circular.prepend << " ns, ";
+	output << "unprepend " << shift.unprepend << " -> " << circular.unprepend << " ns, ";
+	output << "append " << shift.append << " -> " << circular.append << " ns\n";
+}
+
+// Fills and empties a Deque<std::uint32_t> of several capacities, against ArrayShiftDeque
+inline void benchmarkDeque(std::ostream & output)
+{
+	output << "Deque: array shift -> circular, best nanoseconds per operation\n";
+
+	benchmarkDequeCapacity<16>(output);
+	benchmarkDequeCapacity<64>(output);
+	benchmarkDequeCapacity<256>(output);
+	benchmarkDequeCapacity<1024>(output);
+}
+
+//
+// Code Benchmark
+//
+
+// Settings that run the same programs from CompactCode
+template< typename Settings >
+struct CompactCodeSettings : Settings
+{
+	using InstructionListType = CompactCode;
+	using EnvironmentSettingsType = CompactCodeSettings;
+};
+
+// A large straight-line program of common instructions.
+// Each block jumps over a Nop so that encoding has targets to rewrite.
+inline InstructionStore createCodeBenchmarkProgram(std::size_t blockCount)
+{
+	InstructionStore instructions;
+
+	instructions.reserve((blockCount * 7) + 1);
+
+	Word value = 12345;
+
+	for (std::size_t block = 0; block < blockCount; ++block)
+	{
+		value = ((value * 1103515245u) + 12345u);
+
+		instructions.add(Instruction(Opcode::Push, (value >> 8) & 0xFFFFF));
+		instructions.add(Instruction(Opcode::AddImmediate, value & 0xFF));
+		instructions.add(Instruction(Opcode::Duplicate));
+		instructions.add(Instruction(Opcode::Add));
+		instructions.add(Instruction(Opcode::JumpRelative, 1));
+		instructions.add(Instruction(Opcode::Nop));
+		instructions.add(Instruction(Opcode::Drop, 1));
+	}
+
+	instructions.add(Instruction(Opcode::End));
+
+	return instructions;
+}
+
+// Returns the best time in nanoseconds, or a negative time if the program failed
+template< typename Settings, typename InstructionList >
+double timeProgram(typename Settings::PrinterType & printer, const InstructionList & instructions, std::size_t runs)
+{
+	using ProcessorType = Processor<Settings>;
+	using EnvironmentType = typename ProcessorType::EnvironmentType;
+
+	double best = -1;
+
+	for (std::size_t run = 0; run < runs; ++run)
+	{
+		auto processor = ProcessorType(EnvironmentType(printer, instructions, typename EnvironmentType::ConstantListType()));
+
+		const auto start = BenchmarkClock::now();
+		const auto result = processor.run();
+		const double time = getNanosecondsSince(start);
+
+		if (result.isError())
+			return -1;
+
+		if ((best < 0) || (time < best))
+			best = time;
+	}
+
+	return best;
+}
+
+// Interprets the same large program from an InstructionStore and from CompactCode
+template< typename Settings >
+void benchmarkCode(typename Settings::PrinterType & printer, std::ostream & output)
+{
+	constexpr std::size_t BlockCount = 250000;
+	constexpr std::size_t Runs = 10;
+
+	const InstructionStore store = createCodeBenchmarkProgram(BlockCount);
+	const CompactCode compact = CompactCode::encode(store);
+
+	const double storeTime = timeProgram<Settings>(printer, store, Runs);
+	const double compactTime = timeProgram<CompactCodeSettings<Settings>>(printer, compact, Runs);
+
+	output << "Code: " << store.getCount() << " instructions, best of " << Runs << " runs\n";
+	output << "  InstructionStore " << (store.getCount() * sizeof(Instruction)) << " bytes, " << (storeTime / 1000000) << " ms\n";
+	output << "  CompactCode      " << compact.getSize() << " bytes, " << (compactTime / 1000000) << " ms\n";
+
+	if ((storeTime > 0) && (compactTime > 0))
+		output << "  CompactCode takes " << (compactTime / storeTime) << " times as long\n";
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#if defined(_WIN32)
+#include <io.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define BUFFERED_PRINTER_POSIX
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+//
+// A printer that collects its output in a buffer and hands it to the operating system
+// in one write(2) when the buffer fills or when flush is called,
+// rather than going through iostreams a character at a time.
+//
+// Integers are left to PrinterDecorator, which formats them into a single string.
+// The processor flushes its printer on End, Break and error (see PrinterDecorator::flush),
+// and the printer flushes itself when it is destroyed.
+// Anything written to the same file some other way, e.g. through std::cout,
+// must be flushed before the printer next writes or the two will be interleaved out of order.
+//
+
+class BufferedPrinter
+{
+public:
+	static constexpr std::size_t BufferSize = 0x10000;
+
+	static constexpr int StandardOutput = 1;
+	static constexpr int StandardError = 2;
+
+private:
+	std::unique_ptr<char[]> buffer { new char[BufferSize] };
+	std::size_t used = 0;
+	int fileDescriptor = StandardOutput;
+
+public:
+	BufferedPrinter(void) = default;
+
+	explicit BufferedPrinter(int fileDescriptor)
+		: fileDescriptor(fileDescriptor)
+	{
+	}
+
+	BufferedPrinter(const BufferedPrinter &) = delete;
+	BufferedPrinter & operator =(const BufferedPrinter &) = delete;
+
+	// The printer moved from is left with nothing to write
+	BufferedPrinter(BufferedPrinter && other)
+		: buffer(std::move(other.buffer)), used(other.used), fileDescriptor(other.fileDescriptor)
+	{
+		other.used = 0;
+	}
+
+	BufferedPrinter & operator =(BufferedPrinter && other)
+	{
+		this->flush();
+		this->buffer = std::move(other.buffer);
+		this->used = other.used;
+		this->fileDescriptor = other.fileDescriptor;
+		other.used = 0;
+		return *this;
+	}
+
+	~BufferedPrinter(void)
+	{
+		this->flush();
+	}
+
+	// Returns false if the output couldn't be written, in which case it is discarded
+	bool flush(void);
+
+	void print(char character)
+	{
+		if (this->used == BufferSize)
+			this->flush();
+
+		this->buffer[this->used] = character;
+		++this->used;
+	}
+
+	void print(const char * nullString)
+	{
+		this->print(nullString, std::strlen(nullString));
+	}
+
+	void print(const char * string, std::size_t length);
+
+	void print(long double value)
+	{
+		char digits[64];
+		const int length = std::snprintf(digits, sizeof(digits), "%Lg", value);
+
+		if (length > 0)
+			this->print(digits, static_cast<std::size_t>(length));
+	}
+
+	void printLine(void)
+	{
+		this->print('\n');
+	}
+
+private:
+	// Returns false if not everything could be written
+	bool write(const char * data, std::size_t size);
+};
+
+//
+// Definition
+//
+
+inline bool BufferedPrinter::flush(void)
+{
+	const std::size_t size = this->used;
+
+	this->used = 0;
+
+	return (size == 0) || this->write(this->buffer.get(), size);
+}
+
+inline void BufferedPrinter::print(const char * string, std::size_t length)
+{
+	if (length > (BufferSize - this->used))
+	{
+		this->flush();
+
+		// Too big to be worth buffering
+		if (length >= BufferSize)
+		{
+			this->write(string, length);
+			return;
+		}
+	}
+
+	std::memcpy(&this->buffer[this->used], string, length);
+	this->used += length;
+}
+
+inline bool BufferedPrinter::write(const char * data, std::size_t size)
+{
+	while (size > 0)
+	{
+#if defined(BUFFERED_PRINTER_POSIX)
+		const ssize_t written = ::write(this->fileDescriptor, data, size);
+
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			return false;
+		}
+#elif defined(_WIN32)
+		const unsigned int chunk = (size > 0x40000000u) ? 0x40000000u : static_cast<unsigned int>(size);
+		const int written = ::_write(this->fileDescriptor, data, chunk);
+
+		if (written < 0)
+			return false;
+#else
+		std::FILE * file = (this->fileDescriptor == StandardError) ? stderr : stdout;
+		const std::size_t written = std::fwrite(data, 1, size, file);
+
+		if ((written == 0) || (std::fflush(file) != 0))
+			return false;
+#endif
+
+		data += written;
+		size -= static_cast<std::size_t>(written);
+	}
+
+	return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+
+#include <cstring>
+
+#if defined(__AVX2__)
+#define BYTE_ORDER_AVX2
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define BYTE_ORDER_SSSE3
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define BYTE_ORDER_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BYTE_ORDER_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+
+//
+// Byte swapping for data written on a machine of the other byte order.
+//
+// swapWords reverses the bytes of each 4 byte word in place, a whole vector at a time:
+// 16 bytes with SSE2, SSSE3 or NEON and 32 bytes with AVX2, depending on what the compiler targets.
+// SSSE3 and AVX2 do it with a single shuffle, SSE2 with shifts and two half shuffles.
+// Any other target swaps one word at a time.
+//
+
+inline std::uint32_t swapBytes(std::uint32_t value)
+{
+#if defined(_MSC_VER)
+	return _byteswap_ulong(value);
+#elif defined(__GNUC__)
+	return __builtin_bswap32(value);
+#else
+	return ((value >> 24) | ((value >> 8) & 0x0000FF00u) | ((value << 8) & 0x00FF0000u) | (value << 24));
+#endif
+}
+
+inline std::uint16_t swapBytes(std::uint16_t value)
+{
+	return static_cast<std::uint16_t>((value >> 8) | (value << 8));
+}
+
+// O(N)
+// data needn't be aligned
+inline void swapWords(void * data, std::size_t count)
+{
+	unsigned char * bytes = static_cast<unsigned char *>(data);
+	std::size_t index = 0;
+
+#if defined(BYTE_ORDER_AVX2)
+	const __m256i wideMask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; (count - index) >= 8; index += 8)
+	{
+		__m256i * pointer = reinterpret_cast<__m256i *>(&bytes[index * 4]);
+		_mm256_storeu_si256(pointer, _mm256_shuffle_epi8(_mm256_loadu_si256(pointer), wideMask));
+	}
+#endif
+
+#if defined(BYTE_ORDER_SSSE3)
+	const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; (count - index) >= 4; index += 4)
+	{
+		__m128i * pointer = reinterpret_cast<__m128i *>(&bytes[index * 4]);
+		_mm_storeu_si128(pointer, _mm_shuffle_epi8(_mm_loadu_si128(pointer), mask));
+	}
+#elif defined(BYTE_ORDER_SSE2)
+	for (; (count - index) >= 4; index += 4)
+	{
+		__m128i * pointer = reinterpret_cast<__m128i *>(&bytes[index * 4]);
+		const __m128i value = _mm_loadu_si128(pointer);
+
+		// Swap the bytes of each half word, then the half words of each word
+		const __m128i halves = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+		const __m128i words = _mm_shufflehi_epi16(_mm_shufflelo_epi16(halves, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+
+		_mm_storeu_si128(pointer, words);
+	}
+#elif defined(BYTE_ORDER_NEON)
+	for (; (count - index) >= 4; index += 4)
+	{
+		std::uint8_t * pointer = &bytes[index * 4];
+		vst1q_u8(pointer, vrev32q_u8(vld1q_u8(pointer)));
+	}
+#endif
+
+	for (; index < count; ++index)
+	{
+		std::uint32_t word;
+		std::memcpy(&word, &bytes[index * 4], sizeof(word));
+		word = swapBytes(word);
+		std::memcpy(&bytes[index * 4], &word, sizeof(word));
+	}
+}
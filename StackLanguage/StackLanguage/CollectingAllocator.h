@@ -0,0 +1,286 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "AllocationStatistics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+//
+// A HeapAllocator that also reclaims blocks programs have forgotten to free.
+//
+// Collection is mark-sweep. The processor supplies the roots: the data stack,
+// the return stack and the arenas. Any word that points into an allocated block
+// keeps that block alive, and so do the words stored inside live blocks.
+// Words carry no type, so the collector has to be conservative. An integer that
+// happens to look like an address keeps a block alive. A program that rebuilds
+// an address from arithmetic after dropping every copy of it will lose the block.
+//
+// Marking happens in one pause whose length depends on how much is live.
+// Sweeping is lazy: each allocation sweeps at most SweepBudget blocks,
+// so an allocation never pays for all of the garbage at once.
+// Blocks allocated while a sweep is pending are marked immediately.
+//
+// A collection is requested after CollectionThreshold bytes have been allocated
+// or after as many bytes as survived the last collection, whichever is more.
+// The memory has to be able to list its allocations, as LinearMemory can.
+//
+
+class CollectingAllocator
+{
+public:
+	static constexpr bool IsCollecting = true;
+
+	static constexpr std::size_t CollectionThreshold = (64 * 1024);
+	static constexpr std::size_t SweepBudget = 64;
+
+private:
+	struct Block
+	{
+		Address address;
+		Word size;
+		bool marked;
+	};
+
+	using Clock = std::chrono::steady_clock;
+
+private:
+	AllocationStatistics statistics;
+
+	// Every block allocated when marking began, ordered by address
+	std::vector<Block> blocks;
+	std::vector<std::size_t> markStack;
+
+	std::size_t sweepIndex = 0;
+	std::size_t allocatedSinceCollection = 0;
+	std::size_t nextCollection = CollectionThreshold;
+
+public:
+	const AllocationStatistics & getStatistics(void) const
+	{
+		return this->statistics;
+	}
+
+	bool shouldCollect(void) const
+	{
+		return (this->allocatedSinceCollection >= this->nextCollection);
+	}
+
+	bool isSweeping(void) const
+	{
+		return (this->sweepIndex < this->blocks.size());
+	}
+
+	// roots(mark) must call mark(word) for every root word.
+	// Any unfinished sweep is completed first.
+	template< typename Memory, typename Roots >
+	void collect(Memory & memory, Roots && roots);
+
+	// Sweeps at most budget blocks
+	template< typename Memory >
+	void sweep(Memory & memory, std::size_t budget);
+
+	template< typename Memory >
+	void finishSweep(Memory & memory)
+	{
+		this->sweep(memory, this->blocks.size());
+	}
+
+	template< typename Memory >
+	Address allocate(Memory & memory, Word size)
+	{
+		this->sweep(memory, SweepBudget);
+		return this->recordAllocation(memory, memory.allocate(size));
+	}
+
+	template< typename Memory >
+	Address allocateZeroed(Memory & memory, Word count, Word size)
+	{
+		this->sweep(memory, SweepBudget);
+		return this->recordAllocation(memory, memory.allocateZeroed(count, size));
+	}
+
+	template< typename Memory >
+	Address reallocate(Memory & memory, Address address, Word size)
+	{
+		if (address == 0)
+			return this->allocate(memory, size);
+
+		this->sweep(memory, SweepBudget);
+
+		const std::size_t previousSize = memory.getAllocationSize(address);
+		const Address result = memory.reallocate(address, size);
+
+		if (result != 0)
+		{
+			this->statistics.recordDeallocation(previousSize);
+			this->recordAllocation(memory, result);
+		}
+
+		return result;
+	}
+
+	template< typename Memory >
+	bool deallocate(Memory & memory, Address address)
+	{
+		if (address == 0)
+			return true;
+
+		const std::size_t size = memory.getAllocationSize(address);
+
+		if (!memory.deallocate(address))
+			return false;
+
+		this->statistics.recordDeallocation(size);
+		return true;
+	}
+
+private:
+	static std::uint64_t getNanosecondsSince(Clock::time_point start)
+	{
+		return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+	}
+
+	// Returns blocks.size() if word doesn't point into a block
+	std::size_t findBlock(Word word) const
+	{
+		const auto compare = [](Word value, const Block & block) { return (value < block.address); };
+		const auto next = std::upper_bound(this->blocks.begin(), this->blocks.end(), word, compare);
+
+		if (next == this->blocks.begin())
+			return this->blocks.size();
+
+		const auto block = (next - 1);
+		return ((word - block->address) < block->size) ? static_cast<std::size_t>(block - this->blocks.begin()) : this->blocks.size();
+	}
+
+	void mark(Word word)
+	{
+		const std::size_t index = this->findBlock(word);
+
+		if ((index == this->blocks.size()) || this->blocks[index].marked)
+			return;
+
+		this->blocks[index].marked = true;
+		this->markStack.push_back(index);
+	}
+
+	template< typename Memory >
+	Address recordAllocation(Memory & memory, Address address)
+	{
+		if (address == 0)
+			return 0;
+
+		const std::size_t size = memory.getAllocationSize(address);
+
+		this->statistics.recordAllocation(size);
+		this->allocatedSinceCollection += size;
+
+		// Keep the pending sweep away from every old block the new one reuses any part of.
+		// A block whose header the new one covers counts too, as sweeping would read live data as its header.
+		if (this->isSweeping())
+		{
+			const Address end = (address + static_cast<Address>(size) + static_cast<Address>(Memory::HeaderSize));
+			const auto compare = [](Address value, const Block & block) { return (value < (block.address + block.size)); };
+
+			for (auto block = std::upper_bound(this->blocks.begin(), this->blocks.end(), address, compare); (block != this->blocks.end()) && (block->address < end); ++block)
+				block->marked = true;
+		}
+
+		return address;
+	}
+};
+
+//
+// Definition
+//
+
+template< typename Memory, typename Roots >
+void CollectingAllocator::collect(Memory & memory, Roots && roots)
+{
+	this->finishSweep(memory);
+
+	const Clock::time_point start = Clock::now();
+
+	this->blocks.clear();
+	this->sweepIndex = 0;
+
+	memory.forEachAllocation([this](Address address, Word size)
+	{
+		this->blocks.push_back(Block { address, size, false });
+	});
+
+	roots([this](Word word) { this->mark(word); });
+
+	std::size_t liveBytes = 0;
+
+	while (!this->markStack.empty())
+	{
+		const Block block = this->blocks[this->markStack.back()];
+		this->markStack.pop_back();
+
+		liveBytes += block.size;
+
+		for (Word offset = 0; offset < block.size; offset += sizeof(Word))
+		{
+			Word word;
+			if (memory.loadWord(block.address + offset, word))
+				this->mark(word);
+		}
+	}
+
+	this->allocatedSinceCollection = 0;
+	// std::max takes references, a local keeps CollectionThreshold from being odr-used
+	const std::size_t threshold = CollectionThreshold;
+	this->nextCollection = std::max(threshold, liveBytes);
+
+	this->statistics.recordCollection();
+	this->statistics.recordPause(getNanosecondsSince(start));
+}
+
+template< typename Memory >
+void CollectingAllocator::sweep(Memory & memory, std::size_t budget)
+{
+	if (!this->isSweeping())
+		return;
+
+	const Clock::time_point start = Clock::now();
+
+	const std::size_t end = std::min(this->blocks.size(), this->sweepIndex + budget);
+
+	for (; this->sweepIndex < end; ++this->sweepIndex)
+	{
+		const Block & block = this->blocks[this->sweepIndex];
+
+		if (block.marked)
+			continue;
+
+		// Skip blocks the program has freed since marking
+		if (memory.getAllocationSize(block.address) != block.size)
+			continue;
+
+		if (memory.deallocate(block.address))
+			this->statistics.recordReclamation(block.size);
+	}
+
+	this->statistics.recordPause(getNanosecondsSince(start));
+}
@@ -0,0 +1,396 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Opcode.h"
+#include "Instruction.h"
+
+#include <memory>
+#include <new>
+#include <vector>
+
+//
+// A variable-length encoding of a program, selected with Settings::InstructionListType.
+//
+// Each instruction starts with a byte holding its opcode's index in CompactOpcodes in the low 6 bits
+// and the number of operand bytes that follow in the top 2 bits.
+// The operand is stored little-endian in 0 to 3 bytes, 3 being enough for every 24-bit operand,
+// so an Add takes 1 byte and a Push of a character takes 2.
+//
+// Instruction addresses are byte offsets, so encode rewrites the targets of Call, JumpAbsolute
+// and JumpRelative as it goes. Addresses that a program computes or pushes itself,
+// e.g. for CallIndirect, can't be found and must already be byte offsets.
+// encode keeps the offset of every original instruction so that
+// other indices, such as a module's entry point, can be translated with translateAddress.
+// A lazy Module works in instruction indices throughout, so it can't be run from CompactCode.
+//
+// Decoding costs more than reading a fixed-size instruction,
+// so a program runs around one and a half times slower than from an InstructionStore
+// (see benchmarkCode in Benchmark.h).
+//
+// Like InstructionStore, copies share a single buffer.
+//
+
+class CompactCode
+{
+public:
+	static constexpr Byte OpcodeMask = 0x3F;
+	static constexpr Byte WidthShift = 6;
+
+	static constexpr std::size_t CompactOpcodeCount = 59;
+
+private:
+	std::shared_ptr<const Byte> bytes;
+	std::size_t size = 0;
+
+	// The byte offset of each original instruction
+	std::shared_ptr<const Word> offsets;
+	std::size_t instructionCount = 0;
+
+public:
+	CompactCode(void) = default;
+
+	// O(1)
+	bool isEmpty(void) const noexcept
+	{
+		return (this->size == 0);
+	}
+
+	// O(1)
+	// The size in bytes
+	std::size_t getSize(void) const noexcept
+	{
+		return this->size;
+	}
+
+	// O(1)
+	const Byte * getData(void) const noexcept
+	{
+		return this->bytes.get();
+	}
+
+	// O(1)
+	// The byte offset of the instruction that was at index before encoding.
+	// Indices past the end stay past the end, as encode does for jump targets.
+	Address translate(Address index) const noexcept
+	{
+		if (index < this->instructionCount)
+			return this->offsets.get()[index];
+
+		return static_cast<Address>(this->size + (index - this->instructionCount));
+	}
+
+	// Reads the instruction at address, a byte offset, and moves address on to the next one
+	bool fetch(Address & address, Instruction & instruction) const
+	{
+		if (address >= this->size)
+			return false;
+
+		const Byte * data = &this->bytes.get()[address];
+		const Word width = (data[0] >> WidthShift);
+
+		if (width >= (this->size - address))
+			return false;
+
+		Word operand = 0;
+
+		switch (width)
+		{
+		case 3:
+			operand |= (static_cast<Word>(data[3]) << 16);
+			// Falls through
+		case 2:
+			operand |= (static_cast<Word>(data[2]) << 8);
+			// Falls through
+		case 1:
+			operand |= static_cast<Word>(data[1]);
+		}
+
+		instruction = Instruction(getOpcode(data[0] & OpcodeMask), operand);
+		address += (width + 1);
+		return true;
+	}
+
+	// Encodes any list indexed by instruction.
+	// Returns an empty CompactCode if the list is empty or memory runs out.
+	template< typename InstructionList >
+	static CompactCode encode(const InstructionList & instructions);
+
+	static Opcode getOpcode(Byte index)
+	{
+		return (index < CompactOpcodeCount) ? getCompactOpcodes()[index] : static_cast<Opcode>(0xFF);
+	}
+
+	// Returns false if opcode has no compact index
+	static bool getCompactIndex(Opcode opcode, Byte & index)
+	{
+		const Opcode * opcodes = getCompactOpcodes();
+
+		for (Byte candidate = 0; candidate < CompactOpcodeCount; ++candidate)
+			if (opcodes[candidate] == opcode)
+			{
+				index = candidate;
+				return true;
+			}
+
+		return false;
+	}
+
+private:
+	static const Opcode * getCompactOpcodes(void)
+	{
+		static const Opcode opcodes[CompactOpcodeCount] =
+		{
+			// Category 0 - Basic control
+			Opcode::Nop, Opcode::End, Opcode::Break, Opcode::PrintInt, Opcode::PrintChar, Opcode::PrintLine, Opcode::PrintStack, Opcode::Extend,
+
+			// Category 1 - Stack Manipulation
+			Opcode::Push, Opcode::Drop, Opcode::Pick, Opcode::Roll, Opcode::Duplicate, Opcode::Swap, Opcode::Rotate, Opcode::Over, Opcode::PushConstant,
+
+			// Category 2 - Flow Control
+			Opcode::Call, Opcode::CallIndirect, Opcode::Return, Opcode::JumpRelative, Opcode::JumpAbsolute, Opcode::CallNative,
+
+			// Category 3 - Arithmetic
+			Opcode::Add, Opcode::AddImmediate, Opcode::Subtract, Opcode::SubtractImmediate, Opcode::Negate,
+
+			// Category 4 - Bitwise operations
+			Opcode::And, Opcode::AndImmediate, Opcode::Or, Opcode::OrImmediate, Opcode::ExclusiveOr, Opcode::ExclusiveOrImmediate,
+			Opcode::ShiftLeft, Opcode::ShiftLeftImmediate, Opcode::ShiftRight, Opcode::ShiftRightImmediate, Opcode::Not,
+
+			// Category 5 - Bit operations
+			Opcode::BitSet, Opcode::BitClear, Opcode::BitToggle,
+
+			// Category 6 - Load/Store
+			Opcode::LoadByte, Opcode::LoadWord, Opcode::StoreByte, Opcode::StoreWord, Opcode::StoreByteImmediate, Opcode::StoreWordImmediate,
+
+			// Category 7 - Dynamic allocation
+			Opcode::Malloc, Opcode::MallocImmediate, Opcode::Calloc, Opcode::CallocImmediate, Opcode::Realloc, Opcode::ReallocImmediate,
+			Opcode::Free, Opcode::ArenaCreate, Opcode::ArenaAlloc, Opcode::ArenaReset, Opcode::ArenaDestroy,
+		};
+
+		return opcodes;
+	}
+
+	// Opcode::Extend's place in CompactOpcodes
+	static constexpr Byte ExtendIndex = 7;
+
+	// An instruction along with any Extend that precedes it.
+	// The widths only ever grow while the layout settles.
+	struct Entry
+	{
+		Opcode opcode;
+		Byte index;
+		Word operand;
+
+		// The index of the original instruction after this one
+		std::size_t next;
+
+		bool extended;
+		std::size_t extensionWidth;
+		std::size_t operandWidth;
+
+		std::size_t getSize(void) const
+		{
+			return (this->extended ? (1 + this->extensionWidth) : 0) + (1 + this->operandWidth);
+		}
+	};
+
+	static bool isCodeAddress(Opcode opcode)
+	{
+		return (opcode == Opcode::Call) || (opcode == Opcode::JumpAbsolute);
+	}
+
+	static std::size_t getOperandWidth(Word operand)
+	{
+		return (operand == 0) ? 0 : (operand <= 0xFF) ? 1 : (operand <= 0xFFFF) ? 2 : 3;
+	}
+
+	// Returns true if the entry had to grow to fit operand
+	static bool fitEntry(Entry & entry, Word operand)
+	{
+		const bool isInRange = (entry.opcode == Opcode::JumpRelative) ? Instruction::isSignedOperandInRange(static_cast<SWord>(operand)) : Instruction::isOperandInRange(operand);
+
+		const bool extended = (entry.extended || !isInRange);
+		const std::size_t extensionWidth = max(entry.extensionWidth, extended ? getOperandWidth(Instruction::getExtensionOperand(operand)) : 0);
+		const std::size_t operandWidth = max(entry.operandWidth, getOperandWidth(operand & 0x00FFFFFFu));
+
+		const bool changed = (extended != entry.extended) || (extensionWidth != entry.extensionWidth) || (operandWidth != entry.operandWidth);
+
+		entry.extended = extended;
+		entry.extensionWidth = extensionWidth;
+		entry.operandWidth = operandWidth;
+
+		return changed;
+	}
+
+	static std::size_t max(std::size_t left, std::size_t right)
+	{
+		return (left > right) ? left : right;
+	}
+
+	static void writeInstruction(Byte * & output, Byte index, Word operand, std::size_t width)
+	{
+		*output++ = static_cast<Byte>(index | (width << WidthShift));
+
+		for (std::size_t byte = 0; byte < width; ++byte)
+			*output++ = static_cast<Byte>(operand >> (byte * 8));
+	}
+};
+
+//
+// Definition
+//
+
+template< typename InstructionList >
+CompactCode CompactCode::encode(const InstructionList & instructions)
+{
+	const std::size_t count = instructions.getCount();
+
+	std::vector<Entry> entries;
+	entries.reserve(count);
+
+	// Which entry each original instruction belongs to
+	std::vector<std::size_t> entryOf(count);
+
+	for (std::size_t index = 0; index < count; ++index)
+	{
+		Instruction instruction = instructions[index];
+		Word operand = instruction.getOperand();
+
+		entryOf[index] = entries.size();
+
+		// Fold Extend into the instruction it extends
+		if ((instruction.getOpcode() == Opcode::Extend) && ((index + 1) < count))
+		{
+			++index;
+			entryOf[index] = entries.size();
+			instruction = instructions[index];
+			operand = ((operand << 24) | instruction.getOperand());
+		}
+		else if (instruction.getOpcode() == Opcode::JumpRelative)
+		{
+			operand = static_cast<Word>(instruction.getSignedOperand());
+		}
+
+		Entry entry = {};
+		entry.opcode = instruction.getOpcode();
+		entry.operand = operand;
+		entry.next = (index + 1);
+
+		if (!getCompactIndex(entry.opcode, entry.index))
+			entry.index = OpcodeMask;
+
+		entries.push_back(entry);
+	}
+
+	// Sizes depend on the targets' offsets and vice versa,
+	// so grow each entry to fit until nothing changes
+	std::vector<std::size_t> offsets(entries.size() + 1);
+	std::vector<Word> operands(entries.size());
+
+	// Targets past the end stay past the end
+	const auto translate = [&](Word target) -> Word
+	{
+		return (target < count) ? static_cast<Word>(offsets[entryOf[target]]) : static_cast<Word>(offsets[entries.size()] + (target - count));
+	};
+
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+
+		for (std::size_t index = 0; index < entries.size(); ++index)
+			offsets[index + 1] = (offsets[index] + entries[index].getSize());
+
+		for (std::size_t index = 0; index < entries.size(); ++index)
+		{
+			Entry & entry = entries[index];
+			Word operand = entry.operand;
+
+			// Relative jumps are measured from the end of the instruction
+			if (isCodeAddress(entry.opcode))
+				operand = translate(operand);
+			else if (entry.opcode == Opcode::JumpRelative)
+				operand = (translate(static_cast<Word>(entry.next + entry.operand)) - static_cast<Word>(offsets[index + 1]));
+
+			operands[index] = operand;
+
+			if (fitEntry(entry, operand))
+				changed = true;
+		}
+	}
+
+	const std::size_t size = offsets[entries.size()];
+
+	if (size == 0)
+		return CompactCode();
+
+	Byte * bytes = new (std::nothrow) Byte[size];
+
+	if (bytes == nullptr)
+		return CompactCode();
+
+	CompactCode result;
+	result.bytes = std::shared_ptr<const Byte>(bytes, std::default_delete<const Byte[]>());
+	result.size = size;
+
+	Word * instructionOffsets = new (std::nothrow) Word[count];
+
+	if (instructionOffsets == nullptr)
+		return CompactCode();
+
+	for (std::size_t index = 0; index < count; ++index)
+		instructionOffsets[index] = static_cast<Word>(offsets[entryOf[index]]);
+
+	result.offsets = std::shared_ptr<const Word>(instructionOffsets, std::default_delete<const Word[]>());
+	result.instructionCount = count;
+
+	Byte * output = bytes;
+
+	for (std::size_t index = 0; index < entries.size(); ++index)
+	{
+		const Entry & entry = entries[index];
+		const Word operand = operands[index];
+
+		if (entry.extended)
+			writeInstruction(output, ExtendIndex, Instruction::getExtensionOperand(operand), entry.extensionWidth);
+
+		writeInstruction(output, entry.index, (operand & 0x00FFFFFFu), entry.operandWidth);
+	}
+
+	return result;
+}
+
+// Lets the processor run CompactCode
+inline bool fetchInstruction(const CompactCode & code, Address & address, Instruction & instruction)
+{
+	return code.fetch(address, instruction);
+}
+
+inline Address translateAddress(const CompactCode & code, Address index)
+{
+	return code.translate(index);
+}
+
+// A lazy Module materialises and calls functions by instruction index
+inline bool isIndexedByInstruction(const CompactCode & code)
+{
+	(void)code;
+	return false;
+}
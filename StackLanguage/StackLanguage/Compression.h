@@ -0,0 +1,259 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+
+#include <cstring>
+#include <vector>
+
+//
+// A small LZ77 compressor in the style of LZ4, for repetitive data such as generated code.
+//
+// Data is compressed in independent chunks of at most CompressionChunkSize bytes,
+// so it can be decompressed a chunk at a time straight into its destination.
+//
+// A chunk is a series of sequences. Each starts with a token byte whose top 4 bits
+// are a count of literal bytes and whose bottom 4 bits are a match length minus MinimumMatch.
+// A count of 15 continues in the following bytes, each adding up to 255.
+// The literals come next, then a 2 byte offset back to the start of the match,
+// then the rest of the match length. The last sequence of a chunk has literals only.
+//
+
+constexpr std::size_t CompressionChunkSize = 0x10000;
+
+namespace Compression
+{
+	constexpr std::size_t MinimumMatch = 4;
+	constexpr std::size_t HashBits = 14;
+	constexpr std::size_t MaximumOffset = 0xFFFF;
+
+	inline std::uint32_t readWord(const Byte * data)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	inline std::size_t hash(std::uint32_t value)
+	{
+		return static_cast<std::size_t>((value * 2654435761u) >> (32 - HashBits));
+	}
+
+	inline void writeLength(std::vector<Byte> & output, std::size_t length)
+	{
+		for (; length >= 0xFF; length -= 0xFF)
+			output.push_back(0xFF);
+
+		output.push_back(static_cast<Byte>(length));
+	}
+
+	// Returns false if the length runs past the end
+	inline bool readLength(const Byte * & input, const Byte * end, std::size_t & length)
+	{
+		for (;;)
+		{
+			if (input == end)
+				return false;
+
+			const Byte value = *input++;
+			length += value;
+
+			if (value != 0xFF)
+				return true;
+		}
+	}
+
+	inline void writeSequence(std::vector<Byte> & output, const Byte * literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength)
+	{
+		const std::size_t matchCode = (matchLength >= MinimumMatch) ? (matchLength - MinimumMatch) : 0;
+
+		output.push_back(static_cast<Byte>(((literalCount < 15) ? literalCount : 15) << 4 | ((matchCode < 15) ? matchCode : 15)));
+
+		if (literalCount >= 15)
+			writeLength(output, literalCount - 15);
+
+		output.insert(output.end(), literals, literals + literalCount);
+
+		if (matchLength == 0)
+			return;
+
+		output.push_back(static_cast<Byte>(offset));
+		output.push_back(static_cast<Byte>(offset >> 8));
+
+		if (matchCode >= 15)
+			writeLength(output, matchCode - 15);
+	}
+}
+
+// Appends the compressed form of one chunk, at most CompressionChunkSize bytes, to output
+inline void compressChunk(const Byte * input, std::size_t size, std::vector<Byte> & output)
+{
+	using namespace Compression;
+
+	std::vector<std::uint32_t> table(static_cast<std::size_t>(1) << HashBits, 0);
+
+	std::size_t literalStart = 0;
+	std::size_t position = 0;
+
+	while ((position + MinimumMatch) <= size)
+	{
+		const std::uint32_t value = readWord(&input[position]);
+		const std::size_t slot = hash(value);
+
+		// Positions are stored plus one so that 0 means empty
+		const std::size_t candidate = table[slot];
+		table[slot] = static_cast<std::uint32_t>(position + 1);
+
+		if ((candidate == 0) || ((position - (candidate - 1)) > MaximumOffset) || (readWord(&input[candidate - 1]) != value))
+		{
+			++position;
+			continue;
+		}
+
+		const std::size_t matchStart = (candidate - 1);
+		std::size_t matchLength = MinimumMatch;
+
+		while (((position + matchLength) < size) && (input[matchStart + matchLength] == input[position + matchLength]))
+			++matchLength;
+
+		writeSequence(output, &input[literalStart], position - literalStart, position - matchStart, matchLength);
+
+		position += matchLength;
+		literalStart = position;
+	}
+
+	writeSequence(output, &input[literalStart], size - literalStart, 0, 0);
+}
+
+// Decompresses one chunk into exactly outputSize bytes.
+// Returns false if the chunk is malformed or doesn't fill the output exactly.
+inline bool decompressChunk(const Byte * input, std::size_t inputSize, Byte * output, std::size_t outputSize)
+{
+	using namespace Compression;
+
+	const Byte * inputEnd = (input + inputSize);
+	std::size_t position = 0;
+
+	while (input != inputEnd)
+	{
+		const Byte token = *input++;
+
+		std::size_t literalCount = (token >> 4);
+
+		if ((literalCount == 15) && !readLength(input, inputEnd, literalCount))
+			return false;
+
+		if ((literalCount > static_cast<std::size_t>(inputEnd - input)) || (literalCount > (outputSize - position)))
+			return false;
+
+		std::memcpy(&output[position], input, literalCount);
+		input += literalCount;
+		position += literalCount;
+
+		// The last sequence has no match
+		if (input == inputEnd)
+			break;
+
+		if ((inputEnd - input) < 2)
+			return false;
+
+		const std::size_t offset = (static_cast<std::size_t>(input[0]) | (static_cast<std::size_t>(input[1]) << 8));
+		input += 2;
+
+		std::size_t matchLength = (token & 0x0F);
+
+		if ((matchLength == 15) && !readLength(input, inputEnd, matchLength))
+			return false;
+
+		matchLength += MinimumMatch;
+
+		if ((offset == 0) || (offset > position) || (matchLength > (outputSize - position)))
+			return false;
+
+		// Matches may overlap their own output, so this copies forwards a byte at a time
+		// unless the source is far enough back
+		Byte * destination = &output[position];
+		const Byte * source = (destination - offset);
+
+		if (offset >= matchLength)
+			std::memcpy(destination, source, matchLength);
+		else
+			for (std::size_t index = 0; index < matchLength; ++index)
+				destination[index] = source[index];
+
+		position += matchLength;
+	}
+
+	return (position == outputSize);
+}
+
+//
+// Framed streams
+//
+// A stream is the chunks of its input in order, each preceded by its compressed size as a 4 byte word.
+// Every chunk but the last decompresses to exactly CompressionChunkSize bytes,
+// so the decompressed size of each chunk is known from the total.
+//
+
+// Appends the compressed form of size bytes to output
+inline void compress(const Byte * input, std::size_t size, std::vector<Byte> & output)
+{
+	for (std::size_t offset = 0; offset < size; offset += CompressionChunkSize)
+	{
+		const std::size_t chunkSize = ((size - offset) < CompressionChunkSize) ? (size - offset) : CompressionChunkSize;
+
+		const std::size_t sizeOffset = output.size();
+		output.resize(sizeOffset + sizeof(std::uint32_t));
+
+		compressChunk(&input[offset], chunkSize, output);
+
+		const std::uint32_t compressedSize = static_cast<std::uint32_t>(output.size() - sizeOffset - sizeof(std::uint32_t));
+		std::memcpy(&output[sizeOffset], &compressedSize, sizeof(compressedSize));
+	}
+}
+
+// Decompresses a stream a chunk at a time into exactly outputSize bytes.
+// Returns false if the stream is malformed or doesn't fill the output exactly.
+inline bool decompress(const Byte * input, std::size_t inputSize, Byte * output, std::size_t outputSize)
+{
+	std::size_t inputOffset = 0;
+
+	for (std::size_t offset = 0; offset < outputSize; offset += CompressionChunkSize)
+	{
+		if ((inputSize - inputOffset) < sizeof(std::uint32_t))
+			return false;
+
+		std::uint32_t compressedSize;
+		std::memcpy(&compressedSize, &input[inputOffset], sizeof(compressedSize));
+		inputOffset += sizeof(compressedSize);
+
+		if (compressedSize > (inputSize - inputOffset))
+			return false;
+
+		const std::size_t chunkSize = ((outputSize - offset) < CompressionChunkSize) ? (outputSize - offset) : CompressionChunkSize;
+
+		if (!decompressChunk(&input[inputOffset], compressedSize, &output[offset], chunkSize))
+			return false;
+
+		inputOffset += compressedSize;
+	}
+
+	return (inputOffset == inputSize);
+}
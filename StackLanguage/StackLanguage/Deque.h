@@ -18,6 +18,7 @@
 
 #include "StdInt.h"
 #include "Utility.h"
+#include "VectorSearch.h"
 
 //
 // Declarations
@@ -26,6 +27,17 @@
 template< typename Type, std::size_t Capacity >
 class Deque;
 
+//
+// A circular buffer.
+//
+// Items are stored in an array whose size is Capacity rounded up to a power of two,
+// so that positions can wrap around with a mask instead of a branch or a division.
+// A Capacity that isn't a power of two still takes the storage of the next one up,
+// e.g. a capacity of 65 takes room for 128 items, so capacities are best chosen as powers of two.
+// Both ends grow and shrink in O(1), and inserting or removing in the middle
+// only moves the items on the shorter side.
+//
+
 template< typename Type, std::size_t CapacityValue >
 class Deque
 {
@@ -40,6 +52,22 @@ public:
 	using IndexType = std::size_t;
 	using IndexOfType = std::size_t;
 
+private:
+
+	//
+	// Helper Functions
+	//
+
+	static constexpr SizeType roundUpToPowerOfTwo(SizeType value, SizeType result = 1)
+	{
+		return (result >= value) ? result : roundUpToPowerOfTwo(value, result * 2);
+	}
+
+	static constexpr SizeType minimum(SizeType left, SizeType right)
+	{
+		return (left < right) ? left : right;
+	}
+
 public:
 
 	//
@@ -51,14 +79,24 @@ public:
 	static constexpr IndexType FirstIndex = static_cast<IndexType>(0);
 	static constexpr IndexType FinalIndex = static_cast<IndexType>(Capacity - 1);
 
+private:
+
+	static constexpr SizeType StorageSize = roundUpToPowerOfTwo(Capacity);
+	static constexpr IndexType IndexMask = static_cast<IndexType>(StorageSize - 1);
+
+	// Items of these types are moved with memmove and never destroyed
+	using IsTriviallyCopyable = std::integral_constant<bool, std::is_trivially_copyable<ValueType>::value>;
+	using IsTriviallyDestructible = std::integral_constant<bool, std::is_trivially_destructible<ValueType>::value>;
+
 private:
 
 	//
 	// Member Variables
 	//
 
-	ValueType items[Capacity] = {};
-	IndexType next = 0;
+	ValueType items[StorageSize] = {};
+	IndexType first = 0;
+	SizeType count = 0;
 
 public:
 
@@ -69,19 +107,19 @@ public:
 	// O(1)
 	bool isEmpty(void) const noexcept
 	{
-		return (this->next == FirstIndex);
+		return (this->count == 0);
 	}
 
 	// O(1)
 	bool isFull(void) const noexcept
 	{
-		return (this->next > FinalIndex);
+		return (this->count >= Capacity);
 	}
 
 	// O(1)
 	SizeType getCount(void) const noexcept
 	{
-		return this->next;
+		return this->count;
 	}
 
 	// O(1)
@@ -99,31 +137,33 @@ public:
 	// O(1)
 	IndexType getLastIndex(void) const noexcept
 	{
-		return (this->next - 1);
+		return (this->count - 1);
 	}
 
 	// O(1)
+	// Only points to every item while isContiguous is true, see linearize
 	ValueType * getData(void) noexcept
 	{
-		return &this->items[FirstIndex];
+		return &this->items[this->first];
 	}
 
 	// O(1)
+	// Only points to every item while isContiguous is true, see linearize
 	const ValueType * getData(void) const noexcept
 	{
-		return &this->items[FirstIndex];
+		return &this->items[this->first];
 	}
 
 	// O(1)
 	ValueType & operator [](IndexType index)
 	{
-		return this->items[index];
+		return this->items[this->getStorageIndex(index)];
 	}
 
 	// O(1)
 	const ValueType & operator [](IndexType index) const
 	{
-		return this->items[index];
+		return this->items[this->getStorageIndex(index)];
 	}
 
 	// O(N)
@@ -150,27 +190,38 @@ public:
 	// O(1)
 	ValueType & getFirst(void)
 	{
-		return this->items[this->getFirstIndex()];
+		return this->items[this->first];
 	}
 
 	// O(1)
 	const ValueType & getFirst(void) const
 	{
-		return this->items[this->getFirstIndex()];
+		return this->items[this->first];
 	}
 
 	// O(1)
 	ValueType & getLast(void)
 	{
-		return this->items[this->getLastIndex()];
+		return this->items[this->getStorageIndex(this->getLastIndex())];
 	}
 
 	// O(1)
 	const ValueType & getLast(void) const
 	{
-		return this->items[this->getLastIndex()];
+		return this->items[this->getStorageIndex(this->getLastIndex())];
 	}
 
+	// O(1)
+	// True if the items haven't wrapped around the end of the buffer
+	bool isContiguous(void) const noexcept
+	{
+		return ((this->first + this->count) <= StorageSize);
+	}
+
+	// O(N)
+	// Moves the items to the start of the buffer so that getData covers all of them
+	void linearize(void);
+
 	// O(1)
 	bool append(const ValueType & item);
 
@@ -183,6 +234,14 @@ public:
 	// O(1)
 	void unprepend(void);
 
+	// O(1) for trivially destructible types, otherwise O(N)
+	// Returns false if there are fewer than amount items
+	bool unappendN(SizeType amount);
+
+	// O(N)
+	// Moves the item at index to the end, the items after it each move back one place
+	bool moveToLast(IndexType index);
+
 	// O(N)
 	bool removeFirst(const ValueType & item);
 
@@ -194,6 +253,38 @@ public:
 
 	// O(N)
 	bool insert(IndexType index, const ValueType & item);
+
+private:
+
+	// O(1)
+	IndexType getStorageIndex(IndexType index) const noexcept
+	{
+		return ((this->first + index) & IndexMask);
+	}
+
+	// O(N)
+	void reverse(IndexType begin, IndexType end);
+
+	// O(N)
+	// Moves amount items from source to destination, the ranges may overlap
+	void moveItems(IndexType destination, IndexType source, SizeType amount)
+	{
+		this->moveItems(destination, source, amount, IsTriviallyCopyable());
+	}
+
+	// O(N)
+	void moveItems(IndexType destination, IndexType source, SizeType amount, std::false_type);
+
+	// O(N)
+	void moveItems(IndexType destination, IndexType source, SizeType amount, std::true_type);
+
+	// O(N)
+	void destroyItems(std::false_type);
+
+	// O(1)
+	void destroyItems(std::true_type)
+	{
+	}
 };
 
 //
@@ -204,17 +295,23 @@ public:
 template< typename Type, std::size_t Capacity >
 void Deque<Type, Capacity>::clear(void)
 {
-	for (IndexType i = 0; i < this->getCount(); ++i)
-		this->items[i].~ValueType();
+	this->destroyItems(IsTriviallyDestructible());
 
-	this->next = FirstIndex;
+	this->first = 0;
+	this->count = 0;
 }
 
 // O(N)
 template< typename Type, std::size_t Capacity >
 void Deque<Type, Capacity>::fill(const ValueType & item)
 {
-	for (IndexType i = 0; i < this->getCount(); ++i)
+	// At most two runs, each a plain loop over an array
+	const SizeType firstRun = minimum(this->count, StorageSize - this->first);
+
+	for (IndexType i = 0; i < firstRun; ++i)
+		this->items[this->first + i] = item;
+
+	for (IndexType i = 0; i < (this->count - firstRun); ++i)
 		this->items[i] = item;
 }
 
@@ -222,20 +319,28 @@ void Deque<Type, Capacity>::fill(const ValueType & item)
 template< typename Type, std::size_t Capacity >
 bool Deque<Type, Capacity>::contains(const ValueType & item) const
 {
-	for (IndexType i = 0; i < this->getCount(); ++i)
-		if (this->items[i] == item)
-			return true;
-
-	return false;
+	return (this->indexOfFirst(item) != InvalidIndex);
 }
 
 // O(N)
 template< typename Type, std::size_t Capacity >
 auto Deque<Type, Capacity>::indexOfFirst(const ValueType & item) const -> IndexOfType
 {
-	for (IndexType i = 0; i < this->getCount(); ++i)
-		if (this->items[i] == item)
-			return i;
+	using Search = VectorSearchFor<ValueType>;
+
+	// The items are at most two runs, the second starting at the front of the buffer
+	const SizeType firstRun = minimum(this->count, StorageSize - this->first);
+	const SizeType secondRun = (this->count - firstRun);
+
+	const SizeType firstIndex = Search::findFirst(&this->items[this->first], firstRun, item);
+
+	if (firstIndex != firstRun)
+		return firstIndex;
+
+	const SizeType secondIndex = Search::findFirst(&this->items[0], secondRun, item);
+
+	if (secondIndex != secondRun)
+		return (firstRun + secondIndex);
 
 	return InvalidIndex;
 }
@@ -244,13 +349,51 @@ auto Deque<Type, Capacity>::indexOfFirst(const ValueType & item) const -> IndexO
 template< typename Type, std::size_t Capacity >
 auto Deque<Type, Capacity>::indexOfLast(const ValueType & item) const -> IndexOfType
 {
-	for (IndexType i = this->getLastIndex(); i > FirstIndex; --i)
-		if (this->items[i] == item)
-			return i;
+	using Search = VectorSearchFor<ValueType>;
+
+	const SizeType firstRun = minimum(this->count, StorageSize - this->first);
+	const SizeType secondRun = (this->count - firstRun);
+
+	const SizeType secondIndex = Search::findLast(&this->items[0], secondRun, item);
+
+	if (secondIndex != secondRun)
+		return (firstRun + secondIndex);
+
+	const SizeType firstIndex = Search::findLast(&this->items[this->first], firstRun, item);
+
+	if (firstIndex != firstRun)
+		return firstIndex;
 
 	return InvalidIndex;
 }
 
+// O(N)
+template< typename Type, std::size_t Capacity >
+void Deque<Type, Capacity>::linearize(void)
+{
+	if (this->first == 0)
+		return;
+
+	// Rotating left by first is three reversals
+	this->reverse(0, this->first);
+	this->reverse(this->first, StorageSize);
+	this->reverse(0, StorageSize);
+
+	this->first = 0;
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+void Deque<Type, Capacity>::reverse(IndexType begin, IndexType end)
+{
+	for (; (begin + 1) < end; ++begin, --end)
+	{
+		ValueType temporary = std::move(this->items[begin]);
+		this->items[begin] = std::move(this->items[end - 1]);
+		this->items[end - 1] = std::move(temporary);
+	}
+}
+
 // O(1)
 template< typename Type, std::size_t Capacity >
 bool Deque<Type, Capacity>::append(const ValueType & item)
@@ -258,9 +401,9 @@ bool Deque<Type, Capacity>::append(const ValueType & item)
 	if (this->isFull())
 		return false;
 
-	this->items[this->next] = item;
+	this->items[this->getStorageIndex(this->count)] = item;
 
-	++this->next;
+	++this->count;
 
 	return true;
 }
@@ -272,12 +415,11 @@ bool Deque<Type, Capacity>::prepend(const ValueType & item)
 	if (this->isFull())
 		return false;
 
-	++this->next;
+	this->first = ((this->first - 1) & IndexMask);
 
-	for (IndexType i = this->next; i > FirstIndex; --i)
-			this->items[i] = std::move(this->items[i - 1]);
+	this->items[this->first] = item;
 
-	this->items[FirstIndex] = item;
+	++this->count;
 
 	return true;
 }
@@ -289,9 +431,9 @@ void Deque<Type, Capacity>::unappend(void)
 	if (this->isEmpty())
 		return;
 
-	--this->next;
+	--this->count;
 
-	this->items[this->next].~ValueType();
+	this->items[this->getStorageIndex(this->count)].~ValueType();
 }
 
 // O(1)
@@ -301,69 +443,80 @@ void Deque<Type, Capacity>::unprepend(void)
 	if (this->isEmpty())
 		return;
 
-	--this->next;
+	this->items[this->first].~ValueType();
 
-	for (IndexType i = 0; i < this->next; ++i)
-			this->items[i] = std::move(this->items[i + 1]);
+	this->first = ((this->first + 1) & IndexMask);
 
-	this->items[this->next].~ValueType();
+	--this->count;
+}
+
+// O(1) for trivially destructible types, otherwise O(N)
+template< typename Type, std::size_t Capacity >
+bool Deque<Type, Capacity>::unappendN(SizeType amount)
+{
+	if (amount > this->count)
+		return false;
+
+	if (!IsTriviallyDestructible::value)
+		for (IndexType i = (this->count - amount); i < this->count; ++i)
+			(*this)[i].~ValueType();
+
+	this->count -= amount;
 
 	return true;
 }
 
 // O(N)
 template< typename Type, std::size_t Capacity >
-bool Deque<Type, Capacity>::removeFirst(const ValueType & item)
+bool Deque<Type, Capacity>::moveToLast(IndexType index)
 {
-	for(IndexType i = 0; i < this->next; ++i)
-		if (this->items[i] == item)
-		{
-			--this->next;
+	if (index >= this->count)
+		return false;
 
-			for (IndexType j = i; j < this->next; ++j)
-				this->items[j] = std::move(this->items[j + 1]);
+	ValueType item = std::move((*this)[index]);
 
-			this->items[this->next].~ValueType();
+	this->moveItems(index, index + 1, this->count - index - 1);
 
-			return true;
-		}
+	(*this)[this->count - 1] = std::move(item);
 
-	return false;
+	return true;
 }
 
 // O(N)
 template< typename Type, std::size_t Capacity >
-bool Deque<Type, Capacity>::removeLast(const ValueType & item)
+bool Deque<Type, Capacity>::removeFirst(const ValueType & item)
 {
-	for(IndexType i = this->next - 1; i > 0; --i)
-		if (this->items[i] == item)
-		{
-			--this->next;
-
-			for (IndexType j = i; j < this->next; ++j)
-				this->items[j] = std::move(this->items[j + 1]);
+	const IndexOfType index = this->indexOfFirst(item);
 
-			this->items[this->next].~ValueType();
+	return (index != InvalidIndex) && this->removeAt(index);
+}
 
-			return true;
-		}
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool Deque<Type, Capacity>::removeLast(const ValueType & item)
+{
+	const IndexOfType index = this->indexOfLast(item);
 
-	return false;
+	return (index != InvalidIndex) && this->removeAt(index);
 }
 
 // O(N)
 template< typename Type, std::size_t Capacity >
 bool Deque<Type, Capacity>::removeAt(IndexType index)
 {
-	if(index >= this->next)
+	if (index >= this->count)
 		return false;
 
-	--this->next;
-
-	for (IndexType i = index; i < this->next; ++i)
-			this->items[i] = std::move(this->items[i + 1]);
-
-	this->items[this->next].~ValueType();
+	if (index < (this->count / 2))
+	{
+		this->moveItems(1, 0, index);
+		this->unprepend();
+	}
+	else
+	{
+		this->moveItems(index, index + 1, this->count - index - 1);
+		this->unappend();
+	}
 
 	return true;
 }
@@ -372,22 +525,91 @@ bool Deque<Type, Capacity>::removeAt(IndexType index)
 template< typename Type, std::size_t Capacity >
 bool Deque<Type, Capacity>::insert(IndexType index, const ValueType & item)
 {
-	if(index >= this->next)
+	if (index >= this->count)
 		return false;
 
 	if (this->isFull())
 		return false;
 
-	++this->next;
+	if (index < (this->count / 2))
+	{
+		this->first = ((this->first - 1) & IndexMask);
+		++this->count;
 
-	for (IndexType i = index + 1; i < this->next; ++i)
-		this->items[i] = std::move(this->items[i + 1]);
+		this->moveItems(0, 1, index);
+	}
+	else
+	{
+		++this->count;
 
-	this->items[index] = item;
+		this->moveItems(index + 1, index, this->count - index - 1);
+	}
+
+	(*this)[index] = item;
 
 	return true;
 }
 
+// O(N)
+template< typename Type, std::size_t Capacity >
+void Deque<Type, Capacity>::moveItems(IndexType destination, IndexType source, SizeType amount, std::false_type)
+{
+	if (destination <= source)
+	{
+		for (IndexType i = 0; i < amount; ++i)
+			(*this)[destination + i] = std::move((*this)[source + i]);
+	}
+	else
+	{
+		for (IndexType i = amount; i > 0; --i)
+			(*this)[destination + i - 1] = std::move((*this)[source + i - 1]);
+	}
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+void Deque<Type, Capacity>::moveItems(IndexType destination, IndexType source, SizeType amount, std::true_type)
+{
+	// Each memmove covers a piece where neither range wraps,
+	// taken in the same order memmove itself would use
+	if (destination <= source)
+	{
+		while (amount > 0)
+		{
+			const IndexType from = this->getStorageIndex(source);
+			const IndexType to = this->getStorageIndex(destination);
+			const SizeType length = minimum(amount, minimum(StorageSize - from, StorageSize - to));
+
+			std::memmove(&this->items[to], &this->items[from], length * sizeof(ValueType));
+
+			source += length;
+			destination += length;
+			amount -= length;
+		}
+	}
+	else
+	{
+		while (amount > 0)
+		{
+			const IndexType from = this->getStorageIndex(source + amount - 1);
+			const IndexType to = this->getStorageIndex(destination + amount - 1);
+			const SizeType length = minimum(amount, minimum(from + 1, to + 1));
+
+			std::memmove(&this->items[to + 1 - length], &this->items[from + 1 - length], length * sizeof(ValueType));
+
+			amount -= length;
+		}
+	}
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+void Deque<Type, Capacity>::destroyItems(std::false_type)
+{
+	for (IndexType i = 0; i < this->getCount(); ++i)
+		(*this)[i].~ValueType();
+}
+
 //
 // Empty Deque
 //
@@ -17,6 +17,7 @@
 //
 
 #include "Instruction.h"
+#include "ArrayView.h"
 #include "List.h"
 
 template< typename Settings >
@@ -30,11 +31,13 @@ public:
 
 public:
 	using PrinterType = typename SettingsType::PrinterType;
-	using InstructionListType = List<Instruction, InstructionListSize>;
+	using InstructionListType = typename SettingsType::InstructionListType;
+	using ConstantListType = ArrayView<Word>;
 
 private:
 	PrinterType & printer;
 	InstructionListType instructions;
+	ConstantListType constants;
 
 public:
 
@@ -45,6 +48,11 @@ public:
 	{
 	}
 
+	Environment(PrinterType & printer, InstructionListType instructions, ConstantListType constants)
+		: printer(printer), instructions(instructions), constants(constants)
+	{
+	}
+
 public:
 	PrinterType & getPrinter(void)
 	{
@@ -65,4 +73,9 @@ public:
 	{
 		return this->instructions;
 	}
+
+	const ConstantListType & getConstants(void) const
+	{
+		return this->constants;
+	}
 };
\ No newline at end of file
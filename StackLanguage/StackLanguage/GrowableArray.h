@@ -0,0 +1,457 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "Utility.h"
+#include "VectorSearch.h"
+
+#include <algorithm>
+#include <new>
+
+//
+// A contiguous array that starts small and doubles in size whenever it runs out of room,
+// up to a capacity limit that can be changed at runtime.
+//
+// CapacityValue is only the initial limit, setCapacity can raise or lower it later.
+// Appending only reaches the allocator when the array is full,
+// otherwise it costs the same compare and store as a Deque.
+//
+// Offers the parts of the Deque interface that Stack relies on,
+// so it can be used as a Stack's container.
+//
+
+template< typename Type, std::size_t CapacityValue >
+class GrowableArray
+{
+public:
+
+	//
+	// Type Aliases
+	//
+
+	using ValueType = Type;
+	using SizeType = std::size_t;
+	using IndexType = std::size_t;
+	using IndexOfType = std::size_t;
+
+public:
+
+	//
+	// Constants
+	//
+
+	static constexpr SizeType Capacity = static_cast<SizeType>(CapacityValue);
+	static constexpr IndexOfType InvalidIndex = static_cast<IndexOfType>(~0);
+	static constexpr IndexType FirstIndex = static_cast<IndexType>(0);
+	static constexpr IndexType FinalIndex = static_cast<IndexType>(Capacity - 1);
+
+	static constexpr SizeType InitialAllocation = 16;
+
+private:
+
+	//
+	// Member Variables
+	//
+
+	ValueType * items = nullptr;
+	SizeType count = 0;
+	SizeType allocated = 0;
+	SizeType capacity = Capacity;
+
+	// The lesser of allocated and capacity, so append's fast path is a single compare
+	SizeType limit = 0;
+
+public:
+
+	//
+	// Constructors
+	//
+
+	GrowableArray(void) = default;
+
+	// A copy keeps every item, even beyond a lowered capacity.
+	// Running out of memory throws std::bad_alloc instead of leaving the copy empty.
+	GrowableArray(const GrowableArray & other)
+		: capacity(other.capacity)
+	{
+		if (other.count == 0)
+			return;
+
+		this->items = new ValueType[other.count];
+		this->allocated = other.count;
+		this->limit = std::min(this->allocated, this->capacity);
+
+		for (IndexType i = 0; i < other.count; ++i)
+			this->items[i] = other.items[i];
+
+		this->count = other.count;
+	}
+
+	GrowableArray(GrowableArray && other) noexcept
+		: items(other.items), count(other.count), allocated(other.allocated), capacity(other.capacity), limit(other.limit)
+	{
+		other.items = nullptr;
+		other.count = 0;
+		other.allocated = 0;
+		other.limit = 0;
+	}
+
+	GrowableArray & operator =(const GrowableArray & other)
+	{
+		if (this != &other)
+		{
+			GrowableArray copy = other;
+			*this = std::move(copy);
+		}
+
+		return *this;
+	}
+
+	GrowableArray & operator =(GrowableArray && other) noexcept
+	{
+		std::swap(this->items, other.items);
+		std::swap(this->count, other.count);
+		std::swap(this->allocated, other.allocated);
+		std::swap(this->capacity, other.capacity);
+		std::swap(this->limit, other.limit);
+		return *this;
+	}
+
+	~GrowableArray(void)
+	{
+		delete[] this->items;
+	}
+
+public:
+
+	//
+	// Common Member Functions
+	//
+
+	// O(1)
+	bool isEmpty(void) const noexcept
+	{
+		return (this->count == 0);
+	}
+
+	// O(1)
+	bool isFull(void) const noexcept
+	{
+		return (this->count >= this->capacity);
+	}
+
+	// O(1)
+	SizeType getCount(void) const noexcept
+	{
+		return this->count;
+	}
+
+	// O(1)
+	SizeType getCapacity(void) const noexcept
+	{
+		return this->capacity;
+	}
+
+	// O(1)
+	// Items beyond a lowered capacity are kept, but nothing more can be appended until they're removed
+	void setCapacity(SizeType capacity) noexcept
+	{
+		this->capacity = capacity;
+		this->limit = std::min(this->allocated, capacity);
+	}
+
+	// O(1)
+	// The number of items there is currently room for without growing
+	SizeType getAllocatedCount(void) const noexcept
+	{
+		return this->allocated;
+	}
+
+	// O(1)
+	constexpr IndexType getFirstIndex(void) const noexcept
+	{
+		return FirstIndex;
+	}
+
+	// O(1)
+	IndexType getLastIndex(void) const noexcept
+	{
+		return (this->count - 1);
+	}
+
+	// O(1)
+	ValueType * getData(void) noexcept
+	{
+		return this->items;
+	}
+
+	// O(1)
+	const ValueType * getData(void) const noexcept
+	{
+		return this->items;
+	}
+
+	// O(1)
+	ValueType & operator [](IndexType index)
+	{
+		return this->items[index];
+	}
+
+	// O(1)
+	const ValueType & operator [](IndexType index) const
+	{
+		return this->items[index];
+	}
+
+	// O(1)
+	// Keeps the allocation for reuse
+	void clear(void)
+	{
+		this->count = 0;
+	}
+
+	// O(N)
+	void fill(const ValueType & item)
+	{
+		for (IndexType i = 0; i < this->count; ++i)
+			this->items[i] = item;
+	}
+
+	// O(N)
+	bool contains(const ValueType & item) const
+	{
+		return (this->indexOfFirst(item) != InvalidIndex);
+	}
+
+	// O(N)
+	IndexOfType indexOfFirst(const ValueType & item) const
+	{
+		const SizeType index = VectorSearchFor<ValueType>::findFirst(this->items, this->count, item);
+		return (index != this->count) ? index : InvalidIndex;
+	}
+
+	// O(N)
+	IndexOfType indexOfLast(const ValueType & item) const
+	{
+		const SizeType index = VectorSearchFor<ValueType>::findLast(this->items, this->count, item);
+		return (index != this->count) ? index : InvalidIndex;
+	}
+
+public:
+
+	//
+	// Specific Member Functions
+	//
+
+	// O(1)
+	ValueType & getFirst(void)
+	{
+		return this->items[FirstIndex];
+	}
+
+	// O(1)
+	const ValueType & getFirst(void) const
+	{
+		return this->items[FirstIndex];
+	}
+
+	// O(1)
+	ValueType & getLast(void)
+	{
+		return this->items[this->getLastIndex()];
+	}
+
+	// O(1)
+	const ValueType & getLast(void) const
+	{
+		return this->items[this->getLastIndex()];
+	}
+
+	// Amortised O(1)
+	bool append(const ValueType & item)
+	{
+		if (this->count >= this->limit)
+			return this->growAndAppend(item);
+
+		this->items[this->count] = item;
+
+		++this->count;
+
+		return true;
+	}
+
+	// O(1)
+	void unappend(void)
+	{
+		if (this->isEmpty())
+			return;
+
+		--this->count;
+	}
+
+	// O(1)
+	// Returns false if there are fewer than amount items
+	bool unappendN(SizeType amount)
+	{
+		if (amount > this->count)
+			return false;
+
+		this->count -= amount;
+
+		return true;
+	}
+
+	// O(N)
+	// Moves the item at index to the end, the items after it each move back one place
+	bool moveToLast(IndexType index);
+
+	// O(N)
+	bool removeFirst(const ValueType & item)
+	{
+		const IndexOfType index = this->indexOfFirst(item);
+
+		return (index != InvalidIndex) && this->removeAt(index);
+	}
+
+	// O(N)
+	bool removeLast(const ValueType & item)
+	{
+		const IndexOfType index = this->indexOfLast(item);
+
+		return (index != InvalidIndex) && this->removeAt(index);
+	}
+
+	// O(N)
+	bool removeAt(IndexType index);
+
+	// O(N)
+	bool insert(IndexType index, const ValueType & item);
+
+	// O(N)
+	// Returns false if amount exceeds the capacity or the allocation failed
+	bool reserve(SizeType amount);
+
+private:
+
+	// O(N)
+	// The slow path of append, item may refer to one of the current items
+	bool growAndAppend(const ValueType & item);
+};
+
+//
+// Definition
+//
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool GrowableArray<Type, Capacity>::removeAt(IndexType index)
+{
+	if (index >= this->count)
+		return false;
+
+	std::move(&this->items[index + 1], &this->items[this->count], &this->items[index]);
+
+	--this->count;
+
+	return true;
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool GrowableArray<Type, Capacity>::moveToLast(IndexType index)
+{
+	if (index >= this->count)
+		return false;
+
+	ValueType item = std::move(this->items[index]);
+
+	std::move(&this->items[index + 1], &this->items[this->count], &this->items[index]);
+
+	this->items[this->count - 1] = std::move(item);
+
+	return true;
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool GrowableArray<Type, Capacity>::insert(IndexType index, const ValueType & item)
+{
+	if (index >= this->count)
+		return false;
+
+	const ValueType copy = item;
+
+	if (!this->append(this->getLast()))
+		return false;
+
+	std::move_backward(&this->items[index], &this->items[this->count - 2], &this->items[this->count - 1]);
+
+	this->items[index] = copy;
+
+	return true;
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool GrowableArray<Type, Capacity>::reserve(SizeType amount)
+{
+	if (amount <= this->allocated)
+		return true;
+
+	if (amount > this->capacity)
+		return false;
+
+	ValueType * items = new (std::nothrow) ValueType[amount];
+
+	if (items == nullptr)
+		return false;
+
+	for (IndexType i = 0; i < this->count; ++i)
+		items[i] = std::move(this->items[i]);
+
+	delete[] this->items;
+
+	this->items = items;
+	this->allocated = amount;
+	this->limit = std::min(amount, this->capacity);
+
+	return true;
+}
+
+// O(N)
+template< typename Type, std::size_t Capacity >
+bool GrowableArray<Type, Capacity>::growAndAppend(const ValueType & item)
+{
+	if (this->count >= this->capacity)
+		return false;
+
+	const SizeType doubled = (this->allocated > 0) ? (this->allocated * 2) : InitialAllocation;
+	const SizeType amount = (doubled < this->capacity) ? doubled : this->capacity;
+
+	// Reallocating would leave item dangling
+	const ValueType copy = item;
+
+	if (!this->reserve(amount))
+		return false;
+
+	this->items[this->count] = copy;
+
+	++this->count;
+
+	return true;
+}
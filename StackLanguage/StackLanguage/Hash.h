@@ -0,0 +1,46 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+
+//
+// 64-bit FNV-1a, for keying caches by content.
+// Not suitable where an attacker chooses the content.
+//
+
+constexpr std::uint64_t HashSeed = 0xCBF29CE484222325u;
+
+inline std::uint64_t hashBytes(const void * data, std::size_t size, std::uint64_t hash = HashSeed)
+{
+	const unsigned char * bytes = static_cast<const unsigned char *>(data);
+
+	for (std::size_t index = 0; index < size; ++index)
+	{
+		hash ^= bytes[index];
+		hash *= 0x100000001B3u;
+	}
+
+	return hash;
+}
+
+template< typename Type >
+std::uint64_t hashValue(const Type & value, std::uint64_t hash = HashSeed)
+{
+	return hashBytes(&value, sizeof(value), hash);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "AllocationStatistics.h"
+
+//
+// Passes every Category 7 request straight through to the memory's own heap.
+//
+
+class HeapAllocator
+{
+public:
+	static constexpr bool IsCollecting = false;
+
+private:
+	AllocationStatistics statistics;
+
+public:
+	const AllocationStatistics & getStatistics(void) const
+	{
+		return this->statistics;
+	}
+
+	template< typename Memory >
+	Address allocate(Memory & memory, Word size)
+	{
+		const Address result = memory.allocate(size);
+
+		if (result != 0)
+			this->statistics.recordAllocation(memory.getAllocationSize(result));
+
+		return result;
+	}
+
+	template< typename Memory >
+	Address allocateZeroed(Memory & memory, Word count, Word size)
+	{
+		const Address result = memory.allocateZeroed(count, size);
+
+		if (result != 0)
+			this->statistics.recordAllocation(memory.getAllocationSize(result));
+
+		return result;
+	}
+
+	template< typename Memory >
+	Address reallocate(Memory & memory, Address address, Word size)
+	{
+		if (address == 0)
+			return this->allocate(memory, size);
+
+		const std::size_t previousSize = memory.getAllocationSize(address);
+		const Address result = memory.reallocate(address, size);
+
+		if (result != 0)
+		{
+			this->statistics.recordDeallocation(previousSize);
+			this->statistics.recordAllocation(memory.getAllocationSize(result));
+		}
+
+		return result;
+	}
+
+	template< typename Memory >
+	bool deallocate(Memory & memory, Address address)
+	{
+		if (address == 0)
+			return true;
+
+		const std::size_t size = memory.getAllocationSize(address);
+
+		if (!memory.deallocate(address))
+			return false;
+
+		this->statistics.recordDeallocation(size);
+		return true;
+	}
+};
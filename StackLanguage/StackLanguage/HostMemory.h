@@ -0,0 +1,117 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+
+#include <cstdlib>
+
+//
+// Treats VM addresses as raw host pointers.
+// There are no bounds checks, so this should only be used with trusted programs
+// on hosts whose pointers fit in an Address.
+//
+
+class HostMemory
+{
+public:
+	static_assert(sizeof(Address) >= sizeof(void *), "Address isn't large enough to store a pointer");
+
+public:
+	constexpr bool isAvailable(void) const
+	{
+		return true;
+	}
+
+	template< typename Function >
+	bool runGuarded(Function && function)
+	{
+		function();
+		return true;
+	}
+
+	// There's no fixed address to load static data at
+	bool loadStaticData(const Byte * data, std::size_t size)
+	{
+		(void)data;
+		return (size == 0);
+	}
+
+public:
+
+	//
+	// Load/Store
+	//
+
+	bool loadByte(Address address, Word & value) const
+	{
+		value = *reinterpret_cast<const Byte *>(address);
+		return true;
+	}
+
+	bool loadWord(Address address, Word & value) const
+	{
+		value = *reinterpret_cast<const Word *>(address);
+		return true;
+	}
+
+	bool storeByte(Address address, Word value)
+	{
+		*reinterpret_cast<Byte *>(address) = static_cast<Byte>(value);
+		return true;
+	}
+
+	bool storeWord(Address address, Word value)
+	{
+		*reinterpret_cast<Word *>(address) = value;
+		return true;
+	}
+
+public:
+
+	//
+	// Allocation
+	//
+
+	Address allocate(Word size)
+	{
+		return reinterpret_cast<Address>(std::malloc(size));
+	}
+
+	Address allocateZeroed(Word count, Word size)
+	{
+		return reinterpret_cast<Address>(std::calloc(count, size));
+	}
+
+	Address reallocate(Address address, Word size)
+	{
+		return reinterpret_cast<Address>(std::realloc(reinterpret_cast<void *>(address), size));
+	}
+
+	bool deallocate(Address address)
+	{
+		std::free(reinterpret_cast<void *>(address));
+		return true;
+	}
+
+	// The host heap doesn't expose block sizes
+	constexpr Word getAllocationSize(Address address) const
+	{
+		return ((void)address, 0);
+	}
+};
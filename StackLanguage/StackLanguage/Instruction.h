@@ -18,6 +18,7 @@
 
 #include "LanguageTypes.h"
 #include "Opcode.h"
+#include "ArrayView.h"
 
 #include <cstdint>
 
@@ -95,4 +96,56 @@ public:
 	{
 		return signExtend((this->value >> operandShift) & operandMask);
 	}
-};
\ No newline at end of file
+
+	// Operands that don't fit in 24 bits are preceded by an Extend instruction
+	// whose operand holds their top 8 bits
+	constexpr static bool isOperandInRange(Word value)
+	{
+		return ((value & ~operandMask) == 0);
+	}
+
+	constexpr static bool isSignedOperandInRange(SWord value)
+	{
+		return (signExtend(signReduce(value)) == value);
+	}
+
+	constexpr static Word getExtensionOperand(Word value)
+	{
+		return (value >> opcodeShift);
+	}
+};
+
+// A read-only run of instructions, e.g. the code section of a loaded Module
+using InstructionView = ArrayView<Instruction>;
+
+// Reads the instruction at address and moves address on to the next one.
+// Returns false if there is no instruction at address.
+// Works with any list indexed by instruction, other encodings provide their own overload.
+template< typename InstructionList >
+inline bool fetchInstruction(const InstructionList & instructions, Address & address, Instruction & instruction)
+{
+	if (address >= instructions.getCount())
+		return false;
+
+	instruction = instructions[address];
+	++address;
+	return true;
+}
+
+// Turns an instruction index, e.g. a module's entry point, into an address in instructions.
+// Lists indexed by instruction use the index as it is.
+template< typename InstructionList >
+inline Address translateAddress(const InstructionList & instructions, Address index)
+{
+	(void)instructions;
+	return index;
+}
+
+// Returns false if addresses in instructions aren't instruction indices,
+// in which case code can't be materialised from a lazy Module
+template< typename InstructionList >
+inline bool isIndexedByInstruction(const InstructionList & instructions)
+{
+	(void)instructions;
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "Instruction.h"
+#include "Module.h"
+
+#include <memory>
+#include <new>
+
+//
+// A program's instructions, shared by every copy of the store.
+//
+// Copying a store only copies a shared_ptr, so any number of Environments
+// and Processors can run the same program without duplicating it.
+// The store grows as instructions are added, so its size is only limited by the host.
+//
+// Adding to a store that has been copied moves the instructions to a new buffer first,
+// so existing copies never see the change.
+//
+
+class InstructionStore
+{
+public:
+	using ValueType = Instruction;
+	using SizeType = std::size_t;
+	using IndexType = std::size_t;
+
+	static constexpr SizeType InitialAllocation = 16;
+
+private:
+	std::shared_ptr<const ValueType> items;
+
+	// Only set while this store owns a buffer it may add to
+	ValueType * writable = nullptr;
+
+	SizeType count = 0;
+	SizeType allocated = 0;
+
+public:
+	InstructionStore(void) = default;
+
+	// Runs the module's code in place, keeping the module alive
+	explicit InstructionStore(std::shared_ptr<const Module> module)
+		: items(module, module->getCode().getData()), count(module->getCode().getCount())
+	{
+	}
+
+	// O(1)
+	bool isEmpty(void) const noexcept
+	{
+		return (this->count == 0);
+	}
+
+	// O(1)
+	SizeType getCount(void) const noexcept
+	{
+		return this->count;
+	}
+
+	// O(1)
+	const ValueType * getData(void) const noexcept
+	{
+		return this->items.get();
+	}
+
+	// O(1)
+	const ValueType & operator [](IndexType index) const
+	{
+		return this->items.get()[index];
+	}
+
+	// Amortised O(1)
+	// Returns false if the allocation failed
+	bool add(const ValueType & item)
+	{
+		if ((this->count >= this->allocated) || (this->items.use_count() > 1))
+			if (!this->reserve(this->getGrownAllocation()))
+				return false;
+
+		this->writable[this->count] = item;
+
+		++this->count;
+
+		return true;
+	}
+
+	// O(N)
+	// Returns false if the allocation failed
+	bool reserve(SizeType amount);
+
+private:
+	SizeType getGrownAllocation(void) const noexcept
+	{
+		const SizeType minimum = (this->allocated > this->count) ? this->allocated : this->count;
+		return (minimum > 0) ? (minimum * 2) : InitialAllocation;
+	}
+};
+
+//
+// Definition
+//
+
+// O(N)
+inline bool InstructionStore::reserve(SizeType amount)
+{
+	if (amount < this->count)
+		amount = this->count;
+
+	if ((amount <= this->allocated) && (this->items.use_count() <= 1))
+		return true;
+
+	ValueType * items = new (std::nothrow) ValueType[amount];
+
+	if (items == nullptr)
+		return false;
+
+	for (IndexType index = 0; index < this->count; ++index)
+		items[index] = this->items.get()[index];
+
+	this->items = std::shared_ptr<const ValueType>(items, std::default_delete<const ValueType[]>());
+	this->writable = items;
+	this->allocated = amount;
+
+	return true;
+}
@@ -29,5 +29,4 @@ using SWord = std::int32_t;
 using Address = Word;
 using AddressOffset = SWord;
 
-static_assert(sizeof(Address) >= sizeof(void *), "Address isn't large enough to store a pointer");
 static_assert(sizeof(Address) == sizeof(Word), "Address isn't the same size as Word");
\ No newline at end of file
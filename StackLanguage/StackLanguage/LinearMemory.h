@@ -0,0 +1,537 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "Utility.h"
+#include "LanguageTypes.h"
+#include "VirtualMemory.h"
+#include "MemoryGuard.h"
+#include "MemoryImage.h"
+
+#include <cstring>
+
+enum class MemoryBoundsMode
+{
+	// Addresses wrap around at the end of memory, costing a single 'and'.
+	// The memory size must be a power of two.
+	Mask,
+
+	// Out of bounds accesses fail and are reported as errors.
+	Check,
+
+	// Every possible address is reserved and everything past the memory size
+	// is left inaccessible, so accesses need no check at all.
+	// Out of bounds accesses fault and are reported as errors by runGuarded.
+	// Requires a 64-bit POSIX host.
+	Guard,
+};
+
+//
+// A contiguous block of memory owned by a single processor.
+// VM addresses are offsets from the start of the block,
+// so programs can never reach memory outside of it.
+//
+// A program's static data can be loaded at the start of the block,
+// in which case the heap begins after it.
+// Category 7 allocations are served from a simple heap inside the block.
+// Every heap block is preceded by a header word holding its size,
+// and free blocks hold the address of the next free block.
+//
+// Snapshots capture the whole block along with the heap's bookkeeping,
+// see MemoryImage for how they're stored and restored.
+//
+
+template< std::size_t SizeValue, MemoryBoundsMode BoundsModeValue = MemoryBoundsMode::Mask >
+class LinearMemory
+{
+public:
+	using SizeType = std::size_t;
+
+	static constexpr SizeType Size = SizeValue;
+	static constexpr MemoryBoundsMode BoundsMode = BoundsModeValue;
+
+	static_assert((BoundsMode != MemoryBoundsMode::Mask) || ((Size & (Size - 1)) == 0), "Masked memory size must be a power of two");
+	static_assert(Size <= 0x80000000u, "Memory size must be addressable");
+	static_assert((BoundsMode != MemoryBoundsMode::Guard) || MemoryGuard::IsSupported, "Guard bounds mode isn't supported on this host");
+
+	// Where loadStaticData places its data.
+	// Address 0 is left unused so that it can act as null.
+	static constexpr Address StaticDataAddress = sizeof(Word);
+
+	// Every allocated block is preceded by a header of this many bytes
+	static constexpr Word HeaderSize = sizeof(Word);
+
+private:
+	static constexpr Address HeapBase = StaticDataAddress;
+
+	// A word accessed at the last masked address spills over the end
+	static constexpr SizeType ContiguousStorageSize = (Size + sizeof(Word));
+
+	// Any Address plus a word, rounded up to a generous page size
+	static constexpr std::uint64_t GuardStorageSize = ((static_cast<std::uint64_t>(1) << 32) + 0x10000);
+
+	static constexpr SizeType StorageSize = (BoundsMode == MemoryBoundsMode::Guard) ? static_cast<SizeType>(GuardStorageSize) : ContiguousStorageSize;
+
+	static constexpr Word FreeFlag = 0x1;
+	static constexpr Word SizeMask = ~static_cast<Word>(sizeof(Word) - 1);
+
+	static_assert(Size > (HeapBase + HeaderSize + sizeof(Word)), "Memory size is too small");
+
+public:
+	struct Snapshot
+	{
+		MemoryImage image;
+		Address heapStart = HeapBase;
+		Address heapBreak = HeapBase;
+		Address freeList = 0;
+	};
+
+private:
+	Byte * base = nullptr;
+	Address heapStart = HeapBase;
+	Address heapBreak = HeapBase;
+	Address freeList = 0;
+
+public:
+	LinearMemory(void)
+		: base(allocateStorage())
+	{
+	}
+
+	LinearMemory(const LinearMemory &) = delete;
+	LinearMemory & operator =(const LinearMemory &) = delete;
+
+	LinearMemory(LinearMemory && other) noexcept
+		: base(other.base), heapStart(other.heapStart), heapBreak(other.heapBreak), freeList(other.freeList)
+	{
+		other.base = nullptr;
+	}
+
+	LinearMemory & operator =(LinearMemory && other) noexcept
+	{
+		std::swap(this->base, other.base);
+		std::swap(this->heapStart, other.heapStart);
+		std::swap(this->heapBreak, other.heapBreak);
+		std::swap(this->freeList, other.freeList);
+		return *this;
+	}
+
+	~LinearMemory(void)
+	{
+		virtualFree(this->base, StorageSize);
+	}
+
+	bool isAvailable(void) const
+	{
+		return (this->base != nullptr);
+	}
+
+	constexpr SizeType getSize(void) const
+	{
+		return Size;
+	}
+
+	Byte * getData(void)
+	{
+		return this->base;
+	}
+
+	const Byte * getData(void) const
+	{
+		return this->base;
+	}
+
+	Snapshot createSnapshot(void) const
+	{
+		Snapshot snapshot;
+		snapshot.image = MemoryImage::capture(this->base, getImageSize());
+		snapshot.heapStart = this->heapStart;
+		snapshot.heapBreak = this->heapBreak;
+		snapshot.freeList = this->freeList;
+		return snapshot;
+	}
+
+	// Returns false if the snapshot is empty or couldn't be mapped
+	bool restoreSnapshot(const Snapshot & snapshot)
+	{
+		if (!this->isAvailable() || (snapshot.image.getSize() != getImageSize()))
+			return false;
+
+		if (!snapshot.image.restore(this->base))
+			return false;
+
+		this->heapStart = snapshot.heapStart;
+		this->heapBreak = snapshot.heapBreak;
+		this->freeList = snapshot.freeList;
+		return true;
+	}
+
+	// Copies data to StaticDataAddress and starts the heap after it.
+	// Returns false if anything has been allocated or the data doesn't fit.
+	bool loadStaticData(const Byte * data, SizeType size)
+	{
+		if (!this->isAvailable() || (this->heapBreak != this->heapStart) || (this->freeList != 0))
+			return false;
+
+		if (size > (Size - StaticDataAddress - (HeaderSize + sizeof(Word))))
+			return false;
+
+		if (size > 0)
+			std::memcpy(&this->base[StaticDataAddress], data, size);
+
+		this->heapStart = (size > 0) ? (StaticDataAddress + roundSize(static_cast<Word>(size))) : HeapBase;
+		this->heapBreak = this->heapStart;
+		return true;
+	}
+
+	// O(1)
+	// The static data occupies the words from StaticDataAddress up to getStaticDataEnd
+	Address getStaticDataEnd(void) const
+	{
+		return this->heapStart;
+	}
+
+	// Calls function, returning false if it was interrupted by an out of bounds access.
+	// Only Guard mode can be interrupted, in other modes this is a plain call.
+	template< typename Function >
+	bool runGuarded(Function && function)
+	{
+		if (BoundsMode != MemoryBoundsMode::Guard)
+		{
+			function();
+			return true;
+		}
+
+		return MemoryGuard::run(this->base, StorageSize, std::forward<Function>(function));
+	}
+
+public:
+
+	//
+	// Load/Store
+	//
+
+	bool loadByte(Address address, Word & value) const
+	{
+		if (!isInBounds(address, sizeof(Byte)))
+			return false;
+
+		value = this->base[translate(address)];
+		return true;
+	}
+
+	bool loadWord(Address address, Word & value) const
+	{
+		if (!isInBounds(address, sizeof(Word)))
+			return false;
+
+		std::memcpy(&value, &this->base[translate(address)], sizeof(Word));
+		return true;
+	}
+
+	bool storeByte(Address address, Word value)
+	{
+		if (!isInBounds(address, sizeof(Byte)))
+			return false;
+
+		this->base[translate(address)] = static_cast<Byte>(value);
+		return true;
+	}
+
+	bool storeWord(Address address, Word value)
+	{
+		if (!isInBounds(address, sizeof(Word)))
+			return false;
+
+		std::memcpy(&this->base[translate(address)], &value, sizeof(Word));
+		return true;
+	}
+
+public:
+
+	//
+	// Allocation
+	//
+
+	// Returns 0 on failure
+	Address allocate(Word size);
+
+	// Returns 0 on failure
+	Address allocateZeroed(Word count, Word size);
+
+	// Returns 0 on failure, in which case the original block is left intact
+	Address reallocate(Address address, Word size);
+
+	// Returns false if address was not allocated by this memory
+	bool deallocate(Address address);
+
+	// Returns 0 if address isn't an allocated block
+	Word getAllocationSize(Address address) const
+	{
+		if (!this->isBlockAddress(address))
+			return 0;
+
+		const Word header = this->readHeapWord(address - HeaderSize);
+		return ((header & FreeFlag) != 0) ? 0 : (header & SizeMask);
+	}
+
+	// Calls visit(address, size) for every allocated block, lowest address first.
+	// Stops early if the program has corrupted a header.
+	template< typename Visitor >
+	void forEachAllocation(Visitor && visit) const
+	{
+		for (Address header = this->heapStart; header < this->heapBreak; )
+		{
+			const Address address = (header + HeaderSize);
+			const Word value = this->readHeapWord(header);
+			const Word size = (value & SizeMask);
+
+			if (size > (this->heapBreak - address))
+				return;
+
+			if ((value & FreeFlag) == 0)
+				visit(address, size);
+
+			header = (address + size);
+		}
+	}
+
+private:
+	static Byte * allocateStorage(void)
+	{
+		if (BoundsMode != MemoryBoundsMode::Guard)
+			return static_cast<Byte *>(virtualAllocate(StorageSize));
+
+		void * reservation = virtualReserve(StorageSize);
+
+		if (reservation == nullptr)
+			return nullptr;
+
+		if (!virtualCommit(reservation, Size))
+		{
+			virtualFree(reservation, StorageSize);
+			return nullptr;
+		}
+
+		return static_cast<Byte *>(reservation);
+	}
+
+	// Everything accessible, rounded up to whole pages so that images can be mapped over it
+	static SizeType getImageSize(void)
+	{
+		const SizeType accessibleSize = (BoundsMode == MemoryBoundsMode::Guard) ? Size : StorageSize;
+		const SizeType pageSize = virtualPageSize();
+		return (((accessibleSize + (pageSize - 1)) / pageSize) * pageSize);
+	}
+
+	static constexpr Address translate(Address address)
+	{
+		return (BoundsMode == MemoryBoundsMode::Mask) ? static_cast<Address>(address & (Size - 1)) : address;
+	}
+
+	static constexpr bool isInBounds(Address address, SizeType size)
+	{
+		return (BoundsMode != MemoryBoundsMode::Check) || (address <= (Size - size));
+	}
+
+	static constexpr Word roundSize(Word size)
+	{
+		return (size < sizeof(Word)) ? sizeof(Word) : ((size + (sizeof(Word) - 1)) & SizeMask);
+	}
+
+	// The heap only ever touches memory below the break,
+	// so these bypass the bounds mode once an address has been validated
+	Word readHeapWord(Address address) const
+	{
+		Word value;
+		std::memcpy(&value, &this->base[address], sizeof(Word));
+		return value;
+	}
+
+	void writeHeapWord(Address address, Word value)
+	{
+		std::memcpy(&this->base[address], &value, sizeof(Word));
+	}
+
+	// Programs can overwrite headers, so anything taken from the heap is validated before use
+	bool isBlockAddress(Address address) const
+	{
+		if ((address < (this->heapStart + HeaderSize)) || (address >= this->heapBreak) || ((address % sizeof(Word)) != 0))
+			return false;
+
+		const Word size = (this->readHeapWord(address - HeaderSize) & SizeMask);
+		return (size <= (this->heapBreak - address));
+	}
+};
+
+//
+// Definition
+//
+
+template< std::size_t Size, MemoryBoundsMode BoundsMode >
+Address LinearMemory<Size, BoundsMode>::allocate(Word size)
+{
+	if (size > Size)
+		return 0;
+
+	const Word blockSize = roundSize(size);
+
+	// First fit from the free list.
+	// The links live in memory the program can write, so the walk stops at anything
+	// that isn't a free block, and after as many steps as the heap could hold blocks,
+	// in case the program has linked the list into a cycle.
+	const std::size_t stepLimit = ((this->heapBreak - this->heapStart) / (HeaderSize + sizeof(Word)));
+
+	Address previous = 0;
+	std::size_t steps = 0;
+	for (Address current = this->freeList; (steps < stepLimit) && this->isBlockAddress(current); current = this->readHeapWord(current), ++steps)
+	{
+		const Word currentHeader = this->readHeapWord(current - HeaderSize);
+
+		if ((currentHeader & FreeFlag) == 0)
+			break;
+
+		const Word currentSize = (currentHeader & SizeMask);
+
+		if (currentSize >= blockSize)
+		{
+			Address next = this->readHeapWord(current);
+
+			if ((currentSize - blockSize) >= (HeaderSize + sizeof(Word)))
+			{
+				const Address remainder = (current + blockSize + HeaderSize);
+				this->writeHeapWord(remainder - HeaderSize, (currentSize - blockSize - HeaderSize) | FreeFlag);
+				this->writeHeapWord(remainder, next);
+				this->writeHeapWord(current - HeaderSize, blockSize);
+				next = remainder;
+			}
+			else
+			{
+				this->writeHeapWord(current - HeaderSize, currentSize);
+			}
+
+			if (previous == 0)
+				this->freeList = next;
+			else
+				this->writeHeapWord(previous, next);
+
+			return current;
+		}
+
+		previous = current;
+	}
+
+	// Otherwise grow the heap
+	if ((blockSize + HeaderSize) > (Size - this->heapBreak))
+		return 0;
+
+	const Address result = (this->heapBreak + HeaderSize);
+	this->writeHeapWord(this->heapBreak, blockSize);
+	this->heapBreak = (result + blockSize);
+
+	return result;
+}
+
+template< std::size_t Size, MemoryBoundsMode BoundsMode >
+Address LinearMemory<Size, BoundsMode>::allocateZeroed(Word count, Word size)
+{
+	const std::uint64_t total = (static_cast<std::uint64_t>(count) * size);
+
+	if (total > Size)
+		return 0;
+
+	const Address result = this->allocate(static_cast<Word>(total));
+
+	if (result != 0)
+		std::memset(&this->base[result], 0, static_cast<std::size_t>(total));
+
+	return result;
+}
+
+template< std::size_t Size, MemoryBoundsMode BoundsMode >
+Address LinearMemory<Size, BoundsMode>::reallocate(Address address, Word size)
+{
+	if (address == 0)
+		return this->allocate(size);
+
+	if (!this->isBlockAddress(address))
+		return 0;
+
+	const Word header = this->readHeapWord(address - HeaderSize);
+
+	if ((header & FreeFlag) != 0)
+		return 0;
+
+	const Word currentSize = (header & SizeMask);
+
+	if (size <= currentSize)
+		return address;
+
+	if (size > Size)
+		return 0;
+
+	const Word blockSize = roundSize(size);
+
+	// The last block can grow in place
+	if (((address + currentSize) == this->heapBreak) && ((blockSize - currentSize) <= (Size - this->heapBreak)))
+	{
+		this->writeHeapWord(address - HeaderSize, blockSize);
+		this->heapBreak = (address + blockSize);
+		return address;
+	}
+
+	const Address result = this->allocate(size);
+
+	if (result == 0)
+		return 0;
+
+	std::memcpy(&this->base[result], &this->base[address], currentSize);
+	this->deallocate(address);
+
+	return result;
+}
+
+template< std::size_t Size, MemoryBoundsMode BoundsMode >
+bool LinearMemory<Size, BoundsMode>::deallocate(Address address)
+{
+	if (address == 0)
+		return true;
+
+	if (!this->isBlockAddress(address))
+		return false;
+
+	const Word header = this->readHeapWord(address - HeaderSize);
+
+	if ((header & FreeFlag) != 0)
+		return false;
+
+	const Word size = (header & SizeMask);
+
+	// The last block is returned to the unallocated space
+	if ((address + size) == this->heapBreak)
+	{
+		this->heapBreak = (address - HeaderSize);
+		return true;
+	}
+
+	this->writeHeapWord(address - HeaderSize, size | FreeFlag);
+	this->writeHeapWord(address, this->freeList);
+	this->freeList = address;
+
+	return true;
+}
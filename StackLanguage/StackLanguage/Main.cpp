@@ -15,14 +15,24 @@
 //
 
 #include <iostream>
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
 
 #include "Processor.h"
 #include "ResultInfo.h"
-#include "CoutPrinter.h"
+#include "BufferedPrinter.h"
 #include "Settings.h"
+#include "Module.h"
+#include "ModuleBuilder.h"
+#include "MappedFile.h"
+#include "Assembler.h"
+#include "Verifier.h"
+#include "ProgramCache.h"
+#include "Benchmark.h"
 
-using Settings = DefaultSettings<CoutPrinter>;
+using Settings = DefaultSettings<BufferedPrinter>;
 using ProcessorType = Processor<Settings>;
 using EnvironmentType = typename ProcessorType::EnvironmentType;
 using ProcessorStateType = typename ProcessorType::ProcessorStateType;
@@ -60,7 +70,8 @@ int mainNoArguments(void)
 	auto environment = createEnvironment(printer);
 	auto processor = ProcessorType(environment, breakHandler);
 
-	std::cout << "<Begin>\n";
+	// The printer writes to the same file without going through std::cout
+	std::cout << "<Begin>\n" << std::flush;
 
 	auto result = processor.run();
 
@@ -74,30 +85,37 @@ int mainNoArguments(void)
 	return result.isError() ? -1 : 0;
 }
 
-int mainReadFile(const char * file)
+// Raw files hold nothing but instructions, so they're copied into the environment
+int mainReadRawFile(const MappedFile & file)
 {
+	if ((file.getSize() % sizeof(std::uint32_t)) != 0)
+	{
+		std::cerr << "<ERROR>: File is not a whole number of instructions\n";
+		return -1;
+	}
+
 	auto printer = PrinterType();
 	auto environment = EnvironmentType(printer);
 
-	{
-		auto inStream = std::ifstream(file, std::ios::binary | std::ios::in);
+	auto & instructions = environment.getInstructions();
 
-		if (inStream.fail())
-			return -1;
+	if (!instructions.reserve(file.getSize() / sizeof(std::uint32_t)))
+	{
+		std::cerr << "<ERROR>: Not enough memory for the program\n";
+		return -1;
+	}
 
-		while (!inStream.eof())
-		{
-			std::uint32_t value;
-			inStream.read(reinterpret_cast<char *>(&value), sizeof(value));
-			environment.getInstructions().add(Instruction(value));
-		}
+	for (std::size_t offset = 0; offset < file.getSize(); offset += sizeof(std::uint32_t))
+	{
+		std::uint32_t value;
+		std::memcpy(&value, &file.getData()[offset], sizeof(value));
 
-		inStream.close();
+		instructions.add(Instruction(value));
 	}
 
 	auto processor = ProcessorType(environment, breakHandler);
 
-	std::cout << "<Begin>\n";
+	std::cout << "<Begin>\n" << std::flush;
 
 	auto result = processor.run();
 
@@ -109,15 +127,225 @@ int mainReadFile(const char * file)
 	return result.isError() ? -1 : 0;
 }
 
+// Modules are run straight from the mapped file
+int mainRunModule(std::shared_ptr<const Module> module)
+{
+	auto printer = PrinterType();
+	auto environment = EnvironmentType(printer, InstructionStore(module), module->getConstants());
+	auto processor = ProcessorType(environment, breakHandler);
+
+	auto result = processor.loadModule(*module);
+
+	if (result.isError())
+	{
+		std::cerr << "<ERROR>: " << result.getErrorMessage() << '\n';
+		return -1;
+	}
+
+	std::cout << "<Begin>\n" << std::flush;
+
+	result = processor.run();
+
+	if (result.isError())
+		std::cerr << "<ERROR>: " << result.getErrorMessage();
+
+	std::cout << "<End>\n";
+
+	return result.isError() ? -1 : 0;
+}
+
+// Reports any error
+bool verifyModule(const Module & module)
+{
+	auto verifier = Verifier<Settings>();
+
+	const auto result = verifier.verify(module);
+
+	if (result.isError())
+	{
+		std::cerr << "<ERROR>: Instruction " << verifier.getErrorIndex() << ": " << result.getErrorMessage() << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+// Set STACKLANGUAGE_CACHE to an existing directory to keep verified programs between runs
+std::unique_ptr<ProgramCache> openCache(void)
+{
+	const char * directory = std::getenv("STACKLANGUAGE_CACHE");
+
+	if ((directory == nullptr) || (directory[0] == '\0'))
+		return nullptr;
+
+	return std::unique_ptr<ProgramCache>(new ProgramCache(directory, hashSettings<Settings>()));
+}
+
+// Reports any error
+std::shared_ptr<const Module> loadModule(MappedFile file)
+{
+	auto module = std::make_shared<Module>();
+
+	const auto result = module->load(std::move(file));
+
+	if (result.isError())
+	{
+		std::cerr << "<ERROR>: " << result.getErrorMessage() << '\n';
+		return nullptr;
+	}
+
+	if (!verifyModule(*module))
+		return nullptr;
+
+	return module;
+}
+
+// Reports any error
+bool assembleSource(const char * path, const MappedFile & source, ModuleBuilder & builder)
+{
+	auto assembler = Assembler();
+
+	const auto result = assembler.assemble(reinterpret_cast<const char *>(source.getData()), source.getSize(), builder);
+
+	if (result.isError())
+	{
+		std::cerr << "<ERROR>: " << path << '(' << assembler.getErrorLine() << "): " << result.getErrorMessage() << '\n';
+		return false;
+	}
+
+	return true;
+}
+
+// A lazy module is compressed and indexed by function
+int mainAssemble(const char * sourcePath, const char * modulePath, bool compressCode, bool lazy)
+{
+	auto source = MappedFile();
+
+	if (!source.open(sourcePath))
+	{
+		std::cerr << "<ERROR>: File could not be read\n";
+		return -1;
+	}
+
+	auto builder = ModuleBuilder();
+
+	if (!assembleSource(sourcePath, source, builder))
+		return -1;
+
+	builder.setCodeCompressed(compressCode || lazy);
+	builder.setFunctionsIndexed(lazy);
+
+	if (!builder.writeFile(modulePath))
+	{
+		std::cerr << "<ERROR>: Module could not be written\n";
+		return -1;
+	}
+
+	return 0;
+}
+
+bool hasExtension(const char * path, const char * extension)
+{
+	const auto pathLength = std::strlen(path);
+	const auto extensionLength = std::strlen(extension);
+
+	return (pathLength >= extensionLength) && (std::strcmp(&path[pathLength - extensionLength], extension) == 0);
+}
+
+// Turns a module or assembly source into a verified module, going through the cache if there is one.
+// Reports any error.
+std::shared_ptr<const Module> buildProgram(const char * path, MappedFile file)
+{
+	const auto cache = openCache();
+	auto key = ProgramCache::Key();
+
+	if (cache != nullptr)
+	{
+		key = cache->getKey(file.getData(), file.getSize());
+
+		auto module = std::make_shared<Module>();
+
+		if (cache->find(key, *module))
+			return module;
+	}
+
+	if (hasExtension(path, ".sla"))
+	{
+		auto builder = ModuleBuilder();
+
+		if (!assembleSource(path, file, builder))
+			return nullptr;
+
+		const auto image = builder.build();
+		auto buffer = std::unique_ptr<Byte[]>(new Byte[image.size()]);
+
+		std::memcpy(buffer.get(), image.data(), image.size());
+
+		file.adopt(std::move(buffer), image.size());
+	}
+
+	auto module = loadModule(std::move(file));
+
+	// The cache is only an optimisation, so failing to store is ignored
+	if ((module != nullptr) && (cache != nullptr))
+		cache->store(key, module->getImage().getData(), module->getImage().getCount());
+
+	return module;
+}
+
+int mainReadFile(const char * path)
+{
+	auto file = MappedFile();
+
+	if (!file.open(path))
+	{
+		std::cerr << "<ERROR>: File could not be read\n";
+		return -1;
+	}
+
+	if (!hasExtension(path, ".sla") && !Module::isModule(file.getData(), file.getSize()))
+		return mainReadRawFile(file);
+
+	const auto module = buildProgram(path, std::move(file));
+
+	if (module == nullptr)
+		return -1;
+
+	return mainRunModule(module);
+}
+
+int mainBenchmark(void)
+{
+	auto printer = PrinterType();
+
+	benchmarkDeque(std::cout);
+	benchmarkCode<Settings>(printer, std::cout);
+
+	return 0;
+}
+
 int main(int count, const char * args[])
 {
 	if (count == 1)
 		return mainNoArguments();
 	
+	if ((count == 2) && (std::strcmp(args[1], "benchmark") == 0))
+		return mainBenchmark();
+
 	if (count == 2)
 		return mainReadFile(args[1]);
 
-	std::cerr << "Takes one or zero arguments\n";
+	if ((count == 4) && (std::strcmp(args[1], "assemble") == 0))
+		return mainAssemble(args[2], args[3], false, false);
+
+	if ((count == 5) && (std::strcmp(args[1], "assemble") == 0) && (std::strcmp(args[2], "--compress") == 0))
+		return mainAssemble(args[3], args[4], true, false);
+
+	if ((count == 5) && (std::strcmp(args[1], "assemble") == 0) && (std::strcmp(args[2], "--lazy") == 0))
+		return mainAssemble(args[3], args[4], true, true);
+
+	std::cerr << "Usage: StackLanguage [program | assemble [--compress | --lazy] source module | benchmark]\n";
+	std::cerr << "Programs can be modules, raw instructions or assembly source ending in .sla\n";
 
 	return -1;
 }
\ No newline at end of file
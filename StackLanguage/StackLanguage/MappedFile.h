@@ -0,0 +1,242 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <utility>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// The contents of a file, read-only.
+//
+// Where possible the file is mapped into memory rather than read,
+// so opening costs the same however large the file is
+// and pages are only read from disk when they're first used.
+// Elsewhere the whole file is read into a buffer.
+//
+// The contents start on a page boundary when mapped
+// and are suitably aligned for any word type when read.
+//
+
+class MappedFile
+{
+private:
+	const Byte * data = nullptr;
+	std::size_t size = 0;
+	bool mapped = false;
+
+public:
+	MappedFile(void) = default;
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator =(const MappedFile &) = delete;
+
+	MappedFile(MappedFile && other) noexcept
+		: data(other.data), size(other.size), mapped(other.mapped)
+	{
+		other.data = nullptr;
+		other.size = 0;
+		other.mapped = false;
+	}
+
+	MappedFile & operator =(MappedFile && other) noexcept
+	{
+		std::swap(this->data, other.data);
+		std::swap(this->size, other.size);
+		std::swap(this->mapped, other.mapped);
+		return *this;
+	}
+
+	~MappedFile(void)
+	{
+		this->close();
+	}
+
+	bool isOpen(void) const
+	{
+		return (this->data != nullptr);
+	}
+
+	bool isMapped(void) const
+	{
+		return this->mapped;
+	}
+
+	const Byte * getData(void) const
+	{
+		return this->data;
+	}
+
+	std::size_t getSize(void) const
+	{
+		return this->size;
+	}
+
+	// Takes ownership of contents already in memory, e.g. a module built in place
+	void adopt(std::unique_ptr<Byte[]> buffer, std::size_t size)
+	{
+		this->close();
+		this->data = buffer.release();
+		this->size = size;
+		this->mapped = false;
+	}
+
+	// Returns false if the file couldn't be opened or is empty
+	bool open(const char * path)
+	{
+		this->close();
+		return this->map(path) || this->read(path);
+	}
+
+	void close(void)
+	{
+		if (this->data == nullptr)
+			return;
+
+		if (this->mapped)
+			unmap(this->data, this->size);
+		else
+			delete[] this->data;
+
+		this->data = nullptr;
+		this->size = 0;
+		this->mapped = false;
+	}
+
+private:
+	bool map(const char * path)
+	{
+#if defined(_WIN32)
+		HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = nullptr;
+
+		if ((GetFileSizeEx(file, &fileSize) != 0) && (fileSize.QuadPart > 0))
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		CloseHandle(file);
+
+		if (mapping == nullptr)
+			return false;
+
+		// The view keeps the mapping alive
+		void * view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+
+		if (view == nullptr)
+			return false;
+
+		this->data = static_cast<const Byte *>(view);
+		this->size = static_cast<std::size_t>(fileSize.QuadPart);
+		this->mapped = true;
+		return true;
+#elif defined(MAPPED_FILE_POSIX)
+		const int file = ::open(path, O_RDONLY);
+
+		if (file < 0)
+			return false;
+
+		struct stat status;
+		void * view = MAP_FAILED;
+
+		if ((fstat(file, &status) == 0) && (status.st_size > 0))
+			view = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+
+		// The mapping keeps the file alive
+		::close(file);
+
+		if (view == MAP_FAILED)
+			return false;
+
+		this->data = static_cast<const Byte *>(view);
+		this->size = static_cast<std::size_t>(status.st_size);
+		this->mapped = true;
+		return true;
+#else
+		(void)path;
+		return false;
+#endif
+	}
+
+	bool read(const char * path)
+	{
+		std::FILE * file = std::fopen(path, "rb");
+
+		if (file == nullptr)
+			return false;
+
+		long fileSize = -1;
+
+		if (std::fseek(file, 0, SEEK_END) == 0)
+			fileSize = std::ftell(file);
+
+		Byte * buffer = nullptr;
+
+		if ((fileSize > 0) && (std::fseek(file, 0, SEEK_SET) == 0))
+			buffer = new (std::nothrow) Byte[static_cast<std::size_t>(fileSize)];
+
+		const bool success = (buffer != nullptr) && (std::fread(buffer, 1, static_cast<std::size_t>(fileSize), file) == static_cast<std::size_t>(fileSize));
+
+		std::fclose(file);
+
+		if (!success)
+		{
+			delete[] buffer;
+			return false;
+		}
+
+		this->data = buffer;
+		this->size = static_cast<std::size_t>(fileSize);
+		this->mapped = false;
+		return true;
+	}
+
+	static void unmap(const Byte * data, std::size_t size)
+	{
+#if defined(_WIN32)
+		(void)size;
+		UnmapViewOfFile(data);
+#elif defined(MAPPED_FILE_POSIX)
+		munmap(const_cast<Byte *>(data), size);
+#else
+		(void)data;
+		(void)size;
+#endif
+	}
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MEMORY_GUARD_POSIX
+#include <setjmp.h>
+#include <signal.h>
+#include <mutex>
+#endif
+
+//
+// Turns hardware faults inside a reserved address range into a return value.
+//
+// While a guarded function runs, a SIGSEGV or SIGBUS whose address falls in the
+// guarded range jumps straight back out of MemoryGuard::run, which then returns false.
+// Faults anywhere else are passed on to whatever handler was installed before.
+//
+// Nothing on the stack between run and the fault is unwound,
+// so guarded code must not own anything with a non-trivial destructor.
+//
+
+class MemoryGuard
+{
+public:
+#if defined(MEMORY_GUARD_POSIX)
+	static constexpr bool IsSupported = (sizeof(void *) >= sizeof(std::uint64_t));
+#else
+	static constexpr bool IsSupported = false;
+#endif
+
+#if defined(MEMORY_GUARD_POSIX)
+private:
+	struct Region
+	{
+		const char * begin;
+		const char * end;
+		Region * previous;
+		sigjmp_buf jumpBuffer;
+	};
+
+	static Region * & getActiveRegion(void)
+	{
+		static thread_local Region * activeRegion = nullptr;
+		return activeRegion;
+	}
+
+	static struct sigaction & getPreviousAction(int signalNumber)
+	{
+		static struct sigaction previousSegmentationAction;
+		static struct sigaction previousBusAction;
+		return (signalNumber == SIGBUS) ? previousBusAction : previousSegmentationAction;
+	}
+
+	static void handleFault(int signalNumber, siginfo_t * info, void * context)
+	{
+		const char * address = static_cast<const char *>(info->si_addr);
+
+		for (Region * region = getActiveRegion(); region != nullptr; region = region->previous)
+			if ((address >= region->begin) && (address < region->end))
+				siglongjmp(region->jumpBuffer, 1);
+
+		const struct sigaction & previous = getPreviousAction(signalNumber);
+
+		if ((previous.sa_flags & SA_SIGINFO) != 0)
+		{
+			previous.sa_sigaction(signalNumber, info, context);
+		}
+		else if ((previous.sa_handler == SIG_DFL) || (previous.sa_handler == SIG_IGN))
+		{
+			// Returning re-executes the faulting access under the default action
+			signal(signalNumber, SIG_DFL);
+		}
+		else
+		{
+			previous.sa_handler(signalNumber);
+		}
+	}
+
+	static void installHandler(void)
+	{
+		static std::once_flag installed;
+
+		std::call_once(installed, []()
+		{
+			struct sigaction action = {};
+			action.sa_sigaction = &handleFault;
+			action.sa_flags = SA_SIGINFO | SA_NODEFER;
+			sigemptyset(&action.sa_mask);
+
+			sigaction(SIGSEGV, &action, &getPreviousAction(SIGSEGV));
+			sigaction(SIGBUS, &action, &getPreviousAction(SIGBUS));
+		});
+	}
+
+public:
+	// Returns false if function faulted inside [begin, begin + size)
+	template< typename Function >
+	static bool run(const void * begin, std::size_t size, Function && function)
+	{
+		installHandler();
+
+		Region region;
+		region.begin = static_cast<const char *>(begin);
+		region.end = (region.begin + size);
+		region.previous = getActiveRegion();
+
+		if (sigsetjmp(region.jumpBuffer, 1) != 0)
+		{
+			getActiveRegion() = region.previous;
+			return false;
+		}
+
+		getActiveRegion() = &region;
+		function();
+		getActiveRegion() = region.previous;
+
+		return true;
+	}
+#else
+public:
+	template< typename Function >
+	static bool run(const void * begin, std::size_t size, Function && function)
+	{
+		(void)begin;
+		(void)size;
+
+		function();
+		return true;
+	}
+#endif
+};
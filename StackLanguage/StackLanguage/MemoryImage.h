@@ -0,0 +1,227 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "VirtualMemory.h"
+
+#include <cstring>
+#include <memory>
+
+#if defined(VIRTUAL_MEMORY_POSIX) && defined(__linux__)
+#define MEMORY_IMAGE_COPY_ON_WRITE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//
+// A frozen copy of a block of memory that can be written back any number of times.
+//
+// Where possible the copy is kept in an anonymous file and written back by mapping
+// the file privately over the block, so the block shares the image's pages
+// until it writes to them. Restoring is then a single mmap call and each restored block
+// only costs the pages it goes on to modify. Pages that were zero when captured
+// aren't stored at all.
+//
+// Elsewhere the image is a plain copy and restoring is a memcpy.
+//
+
+class MemoryImage
+{
+private:
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+	int file = -1;
+#endif
+	std::unique_ptr<Byte[]> copy;
+	std::size_t size = 0;
+
+public:
+	MemoryImage(void) = default;
+
+	MemoryImage(const MemoryImage &) = delete;
+	MemoryImage & operator =(const MemoryImage &) = delete;
+
+	MemoryImage(MemoryImage && other) noexcept
+		: copy(std::move(other.copy)), size(other.size)
+	{
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+		this->file = other.file;
+		other.file = -1;
+#endif
+		other.size = 0;
+	}
+
+	MemoryImage & operator =(MemoryImage && other) noexcept
+	{
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+		std::swap(this->file, other.file);
+#endif
+		std::swap(this->copy, other.copy);
+		std::swap(this->size, other.size);
+		return *this;
+	}
+
+	~MemoryImage(void)
+	{
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+		if (this->file != -1)
+			close(this->file);
+#endif
+	}
+
+	bool isEmpty(void) const
+	{
+		return (this->size == 0);
+	}
+
+	bool isCopyOnWrite(void) const
+	{
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+		return (this->file != -1);
+#else
+		return false;
+#endif
+	}
+
+	std::size_t getSize(void) const
+	{
+		return this->size;
+	}
+
+	// Copy-on-write images need data to be page aligned memory from virtualAllocate,
+	// and size to be a multiple of the page size
+	static MemoryImage capture(const void * data, std::size_t size);
+
+	// Replaces the first getSize() bytes at data with the image.
+	// data must be the same block the image was captured from, or one laid out identically.
+	bool restore(void * data) const;
+
+private:
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+	static bool isZero(const Byte * data, std::size_t size)
+	{
+		for (std::size_t index = 0; index < size; index += sizeof(std::uint64_t))
+		{
+			std::uint64_t value;
+			std::memcpy(&value, &data[index], sizeof(std::uint64_t));
+
+			if (value != 0)
+				return false;
+		}
+
+		return true;
+	}
+
+	static int captureFile(const Byte * data, std::size_t size);
+#endif
+};
+
+//
+// Definition
+//
+
+inline MemoryImage MemoryImage::capture(const void * data, std::size_t size)
+{
+	MemoryImage result;
+
+	if ((data == nullptr) || (size == 0))
+		return result;
+
+	const Byte * bytes = static_cast<const Byte *>(data);
+
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+	if ((size % virtualPageSize()) == 0)
+	{
+		result.file = captureFile(bytes, size);
+
+		if (result.file != -1)
+		{
+			result.size = size;
+			return result;
+		}
+	}
+#endif
+
+	result.copy.reset(new Byte[size]);
+	std::memcpy(result.copy.get(), bytes, size);
+	result.size = size;
+
+	return result;
+}
+
+inline bool MemoryImage::restore(void * data) const
+{
+	if ((data == nullptr) || this->isEmpty())
+		return false;
+
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+	if (this->file != -1)
+		return (mmap(data, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, this->file, 0) != MAP_FAILED);
+#endif
+
+	std::memcpy(data, this->copy.get(), this->size);
+	return true;
+}
+
+#if defined(MEMORY_IMAGE_COPY_ON_WRITE)
+inline int MemoryImage::captureFile(const Byte * data, std::size_t size)
+{
+	const int file = memfd_create("MemoryImage", MFD_CLOEXEC);
+
+	if (file == -1)
+		return -1;
+
+	// Truncating leaves a hole that reads as zero, so only non-zero pages are written
+	if (ftruncate(file, static_cast<off_t>(size)) != 0)
+	{
+		close(file);
+		return -1;
+	}
+
+	const std::size_t pageSize = virtualPageSize();
+
+	for (std::size_t offset = 0; offset < size; offset += pageSize)
+	{
+		if (isZero(&data[offset], pageSize))
+			continue;
+
+		// Write the whole run of non-zero pages at once
+		std::size_t end = (offset + pageSize);
+		while ((end < size) && !isZero(&data[end], pageSize))
+			end += pageSize;
+
+		for (std::size_t written = offset; written < end; )
+		{
+			const ssize_t result = pwrite(file, &data[written], (end - written), static_cast<off_t>(written));
+
+			if (result <= 0)
+			{
+				close(file);
+				return -1;
+			}
+
+			written += static_cast<std::size_t>(result);
+		}
+
+		offset = (end - pageSize);
+	}
+
+	return file;
+}
+#endif
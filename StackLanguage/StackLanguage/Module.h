@@ -0,0 +1,830 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Instruction.h"
+#include "ArrayView.h"
+#include "MappedFile.h"
+#include "ResultInfo.h"
+#include "Compression.h"
+#include "ByteOrder.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+//
+// Module file format
+//
+// A module begins with a ModuleHeader, followed by sectionCount ModuleSection entries.
+// Each entry gives the offset of its section from the start of the file and its size in bytes.
+// Sections start on 4 byte boundaries so that they can be used where they lie,
+// and each kind of section may appear at most once.
+//
+//   Code       Instructions, one word each
+//   Data       Bytes copied to LinearMemory::StaticDataAddress before the program starts
+//   Constants  Words pushed by PushConstant
+//   Symbols    ModuleSymbol entries, each followed by its name padded to 4 bytes
+//   Functions  ModuleFunction entries in ascending order of address
+//   DataWords  The offsets of the words within the Data section, so that they can be byte swapped
+//
+// A Code section may instead be compressed, marked by ModuleSection::CompressedFlag.
+// It then holds the number of instructions as a word followed by a compressed stream (see Compression.h).
+//
+// A module with both compressed code and a Functions section is lazy:
+// each function is only decompressed when it is first called (see Module::materialize).
+// Control can then only pass between functions by Call, CallIndirect and Return,
+// so every function of a lazy module must end in End, Return or an unconditional jump
+// and its jumps must stay within it.
+//
+// Fields are stored in the byte order of the machine that wrote the module,
+// so the magic number doubles as a byte order mark: it reads as ModuleHeader::SwappedMagic
+// on a machine of the other order. Such a module is byte swapped as it loads (see ByteOrder.h).
+// Data section bytes are left as they are apart from those listed in DataWords.
+// Symbol names and compressed bytes are left as they are too,
+// and compressed code is swapped as it is decompressed.
+//
+
+enum class ModuleSectionType : std::uint32_t
+{
+	Code = 1,
+	Data = 2,
+	Constants = 3,
+	Symbols = 4,
+	Functions = 5,
+	DataWords = 6,
+};
+
+struct ModuleHeader
+{
+	// "SLMD" when read as bytes on a little-endian machine
+	static constexpr std::uint32_t Magic = 0x444D4C53u;
+	static constexpr std::uint32_t SwappedMagic = 0x534C4D44u;
+
+	static constexpr std::uint16_t CurrentVersion = 1;
+
+	std::uint32_t magic;
+	std::uint16_t version;
+
+	// Reserved, must be 0
+	std::uint16_t flags;
+
+	std::uint32_t sectionCount;
+
+	// The index of the first instruction to execute
+	std::uint32_t entryPoint;
+};
+
+struct ModuleSection
+{
+	// Only Code sections may be compressed
+	static constexpr std::uint32_t CompressedFlag = 0x1;
+
+	ModuleSectionType type;
+
+	// CompressedFlag or 0
+	std::uint32_t flags;
+
+	std::uint32_t offset;
+	std::uint32_t size;
+};
+
+struct ModuleSymbol
+{
+	// An instruction index for Code symbols, an address for Data symbols
+	// and an index for Constants symbols
+	std::uint32_t value;
+
+	ModuleSectionType section;
+
+	std::uint32_t nameLength;
+};
+
+struct ModuleFunction
+{
+	// The index of the function's first instruction
+	std::uint32_t address;
+
+	// The number of instructions in the function
+	std::uint32_t count;
+};
+
+static_assert(sizeof(ModuleHeader) == 16, "ModuleHeader must match the file format");
+static_assert(sizeof(ModuleSection) == 16, "ModuleSection must match the file format");
+static_assert(sizeof(ModuleSymbol) == 12, "ModuleSymbol must match the file format");
+static_assert(sizeof(ModuleFunction) == 8, "ModuleFunction must match the file format");
+static_assert(sizeof(Instruction) == sizeof(std::uint32_t), "Code sections are used in place");
+
+//
+// A loaded module.
+//
+// The file is mapped rather than read (see MappedFile),
+// and the code and constants are used straight from the mapping.
+// Compressed code is decompressed once, into a buffer owned by the module.
+// A lazy module's buffer starts out as Nop and is filled a function at a time.
+// Materialising a function isn't synchronised, so a lazy module
+// must not be run by more than one thread at once.
+// Views of the module's sections remain valid for as long as the module does,
+// including after the module is moved.
+//
+
+class Module
+{
+public:
+	using CodeView = InstructionView;
+	using DataView = ArrayView<Byte>;
+	using ConstantView = ArrayView<Word>;
+	using FunctionView = ArrayView<ModuleFunction>;
+
+	// Where the data section is loaded, the same as LinearMemory::StaticDataAddress
+	static constexpr Address DataAddress = sizeof(Word);
+
+private:
+	// One past the highest ModuleSectionType
+	static constexpr std::uint32_t SectionTypeLimit = 7;
+
+	enum class FunctionState : std::uint8_t
+	{
+		Pending,
+		Ready,
+		Invalid,
+	};
+
+	// Decompressed code is allocated zeroed with calloc,
+	// which leaves untouched pages of a large buffer to the operating system
+	struct FreeDeleter
+	{
+		void operator ()(void * pointer) const
+		{
+			std::free(pointer);
+		}
+	};
+
+private:
+	MappedFile file;
+
+	// The file as it was, if file is a byte swapped copy of it
+	MappedFile originalFile;
+	bool codeSwapped = false;
+
+	std::unique_ptr<Instruction[], FreeDeleter> decompressedCode;
+	DataView image;
+	CodeView code;
+	DataView data;
+	ConstantView constants;
+	DataView symbols;
+	FunctionView functions;
+	Address entryPoint = 0;
+
+	// Only used by lazy modules
+	DataView codeStream;
+	std::unique_ptr<std::uint32_t[]> chunkOffsets;
+	std::unique_ptr<bool[]> chunksLoaded;
+	std::unique_ptr<FunctionState[]> functionStates;
+
+	// One bit per instruction, set once a call to that address is known to land in a ready function
+	std::unique_ptr<std::uint32_t[]> callableAddresses;
+
+public:
+	Module(void) = default;
+
+	Module(const Module &) = delete;
+	Module & operator =(const Module &) = delete;
+
+	Module(Module &&) = default;
+	Module & operator =(Module &&) = default;
+
+	// Returns true if data starts like a module, without validating the rest
+	static bool isModule(const Byte * data, std::size_t size)
+	{
+		if (size < sizeof(ModuleHeader))
+			return false;
+
+		std::uint32_t magic;
+		std::memcpy(&magic, data, sizeof(magic));
+		return (magic == ModuleHeader::Magic) || (magic == ModuleHeader::SwappedMagic);
+	}
+
+	ResultInfo load(const char * path)
+	{
+		MappedFile file;
+
+		if (!file.open(path))
+			return resultError("Module could not be read");
+
+		return this->load(std::move(file));
+	}
+
+	// Takes ownership of the file.
+	// The module starts offset bytes into the file, which must be a multiple of 4.
+	ResultInfo load(MappedFile file, std::size_t offset = 0);
+
+	// The whole module as it was loaded, before any byte swapping
+	DataView getImage(void) const
+	{
+		return this->image;
+	}
+
+	CodeView getCode(void) const
+	{
+		return this->code;
+	}
+
+	DataView getData(void) const
+	{
+		return this->data;
+	}
+
+	ConstantView getConstants(void) const
+	{
+		return this->constants;
+	}
+
+	FunctionView getFunctions(void) const
+	{
+		return this->functions;
+	}
+
+	Address getEntryPoint(void) const
+	{
+		return this->entryPoint;
+	}
+
+	bool isLazy(void) const
+	{
+		return (this->functionStates != nullptr);
+	}
+
+	// O(1)
+	// Returns true if a call to address can go ahead without materialize.
+	// Always true for a module that isn't lazy.
+	bool isMaterialized(Address address) const
+	{
+		if (!this->isLazy())
+			return true;
+
+		return (address < this->code.getCount()) && (((this->callableAddresses[address / 32] >> (address % 32)) & 1) != 0);
+	}
+
+	// O(log N) to find the function, O(N) in its size the first time it is materialised.
+	// Decompresses the function containing address, and has check(const Module &, const ModuleFunction &)
+	// vet it before it can be run. A function that fails the check stays unrunnable.
+	template< typename Check >
+	ResultInfo materialize(Address address, Check && check) const;
+
+	// O(N)
+	// Returns false if there is no symbol called name
+	bool findSymbol(const char * name, ModuleSymbol & symbol) const;
+
+private:
+	// Brings everything but the contents of compressed code into the host byte order.
+	// Returns false if the module's layout is malformed.
+	static bool swapImage(Byte * data, std::size_t size);
+
+	ResultInfo loadCompressedCode(const Byte * data, const ModuleSection & section);
+	ResultInfo loadFunctions(const Byte * data, const ModuleSection & section);
+	void prepareLazyCode(void);
+
+	// O(log N)
+	// Returns functions.getCount() if no function contains address
+	std::size_t findFunction(Address address) const;
+
+	// Decompresses the chunks that hold the given instructions
+	bool loadChunks(std::size_t first, std::size_t count) const;
+
+	template< typename Type >
+	static ArrayView<Type> getSectionView(const Byte * data, const ModuleSection & section)
+	{
+		return ArrayView<Type>(reinterpret_cast<const Type *>(&data[section.offset]), section.size / sizeof(Type));
+	}
+};
+
+//
+// Definition
+//
+
+inline ResultInfo Module::load(MappedFile file, std::size_t offset)
+{
+	*this = Module();
+
+	if ((offset > file.getSize()) || ((offset % sizeof(Word)) != 0))
+		return resultError("Not a module");
+
+	const Byte * data = &file.getData()[offset];
+	const std::size_t size = (file.getSize() - offset);
+
+	if (!isModule(data, size))
+		return resultError("Not a module");
+
+	const Byte * originalData = data;
+
+	std::uint32_t magic;
+	std::memcpy(&magic, data, sizeof(magic));
+
+	if (magic == ModuleHeader::SwappedMagic)
+	{
+		auto buffer = std::unique_ptr<Byte[]>(new Byte[size]);
+		std::memcpy(buffer.get(), data, size);
+
+		if (!swapImage(buffer.get(), size))
+			return resultError("Module section table truncated");
+
+		auto swappedFile = MappedFile();
+		swappedFile.adopt(std::move(buffer), size);
+
+		this->originalFile = std::move(file);
+		this->codeSwapped = true;
+
+		file = std::move(swappedFile);
+		data = file.getData();
+	}
+
+	ModuleHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	if ((header.version != ModuleHeader::CurrentVersion) || (header.flags != 0))
+		return resultError("Module version not supported");
+
+	if (header.sectionCount > ((size - sizeof(ModuleHeader)) / sizeof(ModuleSection)))
+		return resultError("Module section table truncated");
+
+	bool present[SectionTypeLimit] = {};
+	ArrayView<std::uint32_t> dataWords;
+
+	for (std::uint32_t index = 0; index < header.sectionCount; ++index)
+	{
+		ModuleSection section;
+		std::memcpy(&section, &data[sizeof(ModuleHeader) + (index * sizeof(ModuleSection))], sizeof(section));
+
+		if ((section.offset > size) || (section.size > (size - section.offset)))
+			return resultError("Module section out of bounds");
+
+		if ((section.offset % sizeof(Word)) != 0)
+			return resultError("Module section malformed");
+
+		const bool compressed = (section.flags == ModuleSection::CompressedFlag);
+
+		if ((section.flags != 0) && (!compressed || (section.type != ModuleSectionType::Code)))
+			return resultError("Module section malformed");
+
+		const std::uint32_t type = static_cast<std::uint32_t>(section.type);
+
+		if ((type == 0) || (type >= SectionTypeLimit))
+			return resultError("Module section type unrecognised");
+
+		if (present[type])
+			return resultError("Module section duplicated");
+
+		present[type] = true;
+
+		switch (section.type)
+		{
+		case ModuleSectionType::Code:
+			if (compressed)
+			{
+				const auto result = this->loadCompressedCode(data, section);
+
+				if (result.isError())
+					return result;
+
+				break;
+			}
+
+			if ((section.size % sizeof(Instruction)) != 0)
+				return resultError("Module section malformed");
+
+			this->code = getSectionView<Instruction>(data, section);
+			break;
+
+		case ModuleSectionType::Data:
+			this->data = getSectionView<Byte>(data, section);
+			break;
+
+		case ModuleSectionType::Constants:
+			if ((section.size % sizeof(Word)) != 0)
+				return resultError("Module section malformed");
+
+			this->constants = getSectionView<Word>(data, section);
+			break;
+
+		case ModuleSectionType::Symbols:
+			this->symbols = getSectionView<Byte>(data, section);
+			break;
+
+		case ModuleSectionType::Functions:
+		{
+			const auto result = this->loadFunctions(data, section);
+
+			if (result.isError())
+				return result;
+
+			break;
+		}
+
+		case ModuleSectionType::DataWords:
+			if ((section.size % sizeof(std::uint32_t)) != 0)
+				return resultError("Module section malformed");
+
+			dataWords = getSectionView<std::uint32_t>(data, section);
+			break;
+		}
+	}
+
+	// Only needed for byte swapping, but a module of either order should load the same
+	for (std::size_t index = 0; index < dataWords.getCount(); ++index)
+		if ((this->data.getCount() < sizeof(Word)) || (dataWords[index] > (this->data.getCount() - sizeof(Word))))
+			return resultError("Module data word out of bounds");
+
+	// Sections can come in any order, so the code isn't known until now
+	if (!this->functions.isEmpty())
+	{
+		const ModuleFunction & last = this->functions[this->functions.getCount() - 1];
+
+		if ((static_cast<std::size_t>(last.address) + last.count) > this->code.getCount())
+			return resultError("Module function out of bounds");
+	}
+
+	if (!this->codeStream.isEmpty())
+	{
+		if (this->functions.isEmpty())
+		{
+			// Without an index, the code can only be used whole
+			if (!this->loadChunks(0, this->code.getCount()))
+				return resultError("Module code could not be decompressed");
+
+			this->codeStream = DataView();
+			this->chunkOffsets.reset();
+			this->chunksLoaded.reset();
+		}
+		else
+			this->prepareLazyCode();
+	}
+
+	if (header.entryPoint > this->code.getCount())
+		return resultError("Module entry point out of bounds");
+
+	this->entryPoint = header.entryPoint;
+	this->image = DataView(originalData, size);
+	this->file = std::move(file);
+
+	return resultSuccess();
+}
+
+inline bool Module::swapImage(Byte * data, std::size_t size)
+{
+	ModuleHeader header;
+	std::memcpy(&header, data, sizeof(header));
+
+	header.magic = swapBytes(header.magic);
+	header.version = swapBytes(header.version);
+	header.flags = swapBytes(header.flags);
+	header.sectionCount = swapBytes(header.sectionCount);
+	header.entryPoint = swapBytes(header.entryPoint);
+
+	std::memcpy(data, &header, sizeof(header));
+
+	if (header.sectionCount > ((size - sizeof(ModuleHeader)) / sizeof(ModuleSection)))
+		return false;
+
+	// Every field of the section table is a word
+	Byte * table = &data[sizeof(ModuleHeader)];
+
+	// The data words can't be swapped until both sections have been found
+	Byte * dataContents = nullptr;
+	std::size_t dataSize = 0;
+	const Byte * dataWords = nullptr;
+	std::size_t dataWordCount = 0;
+	swapWords(table, header.sectionCount * (sizeof(ModuleSection) / sizeof(Word)));
+
+	for (std::uint32_t index = 0; index < header.sectionCount; ++index)
+	{
+		ModuleSection section;
+		std::memcpy(&section, &table[index * sizeof(ModuleSection)], sizeof(section));
+
+		// load reports anything else that is wrong with the section
+		if ((section.offset > size) || (section.size > (size - section.offset)))
+			continue;
+
+		Byte * contents = &data[section.offset];
+
+		switch (section.type)
+		{
+		case ModuleSectionType::Code:
+			if (section.flags != ModuleSection::CompressedFlag)
+			{
+				swapWords(contents, section.size / sizeof(Word));
+				break;
+			}
+
+			if (section.size < sizeof(Word))
+				break;
+
+			// The instruction count, then the size of each chunk
+			swapWords(contents, 1);
+
+			for (std::size_t offset = sizeof(Word); (section.size - offset) >= sizeof(Word); )
+			{
+				swapWords(&contents[offset], 1);
+
+				std::uint32_t compressedSize;
+				std::memcpy(&compressedSize, &contents[offset], sizeof(compressedSize));
+
+				offset += sizeof(Word);
+
+				if (compressedSize > (section.size - offset))
+					break;
+
+				offset += compressedSize;
+			}
+			break;
+
+		case ModuleSectionType::Constants:
+		case ModuleSectionType::Functions:
+			swapWords(contents, section.size / sizeof(Word));
+			break;
+
+		case ModuleSectionType::Data:
+			dataContents = contents;
+			dataSize = section.size;
+			break;
+
+		case ModuleSectionType::DataWords:
+			dataWordCount = (section.size / sizeof(std::uint32_t));
+			swapWords(contents, dataWordCount);
+			dataWords = contents;
+			break;
+
+		case ModuleSectionType::Symbols:
+			for (std::size_t offset = 0; (section.size - offset) >= sizeof(ModuleSymbol); )
+			{
+				swapWords(&contents[offset], sizeof(ModuleSymbol) / sizeof(Word));
+
+				ModuleSymbol symbol;
+				std::memcpy(&symbol, &contents[offset], sizeof(symbol));
+
+				offset += sizeof(ModuleSymbol);
+
+				const std::size_t paddedLength = ((static_cast<std::size_t>(symbol.nameLength) + (sizeof(Word) - 1)) & ~(sizeof(Word) - 1));
+
+				if (paddedLength > (section.size - offset))
+					break;
+
+				offset += paddedLength;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	// Data words needn't be aligned, load reports any that are out of bounds
+	for (std::size_t index = 0; index < dataWordCount; ++index)
+	{
+		std::uint32_t offset;
+		std::memcpy(&offset, &dataWords[index * sizeof(offset)], sizeof(offset));
+
+		if ((dataSize >= sizeof(Word)) && (offset <= (dataSize - sizeof(Word))))
+			swapWords(&dataContents[offset], 1);
+	}
+
+	return true;
+}
+
+inline ResultInfo Module::loadCompressedCode(const Byte * data, const ModuleSection & section)
+{
+	if (section.size < sizeof(std::uint32_t))
+		return resultError("Module section malformed");
+
+	std::uint32_t count;
+	std::memcpy(&count, &data[section.offset], sizeof(count));
+
+	const Byte * stream = &data[section.offset + sizeof(count)];
+	const std::size_t streamSize = (section.size - sizeof(count));
+
+	// Each chunk takes at least a size word and a token, which bounds how much a stream can claim
+	const std::size_t chunkCount = ((static_cast<std::size_t>(count) * sizeof(Instruction)) + (CompressionChunkSize - 1)) / CompressionChunkSize;
+
+	if (chunkCount > (streamSize / (sizeof(std::uint32_t) + 1)))
+		return resultError("Module code could not be decompressed");
+
+	// Where each chunk starts, so that chunks can be decompressed in any order
+	auto offsets = std::unique_ptr<std::uint32_t[]>(new std::uint32_t[chunkCount + 1]);
+	std::size_t offset = 0;
+
+	for (std::size_t index = 0; index < chunkCount; ++index)
+	{
+		if ((streamSize - offset) < sizeof(std::uint32_t))
+			return resultError("Module code could not be decompressed");
+
+		std::uint32_t compressedSize;
+		std::memcpy(&compressedSize, &stream[offset], sizeof(compressedSize));
+
+		offsets[index] = static_cast<std::uint32_t>(offset);
+		offset += sizeof(compressedSize);
+
+		if (compressedSize > (streamSize - offset))
+			return resultError("Module code could not be decompressed");
+
+		offset += compressedSize;
+	}
+
+	if (offset != streamSize)
+		return resultError("Module code could not be decompressed");
+
+	offsets[chunkCount] = static_cast<std::uint32_t>(offset);
+
+	// The chunks are decompressed straight into the buffer that becomes the code
+	this->decompressedCode.reset(static_cast<Instruction *>(std::calloc((count != 0) ? count : 1, sizeof(Instruction))));
+
+	if (this->decompressedCode == nullptr)
+		return resultError("Module code too large to load");
+
+	this->code = CodeView(this->decompressedCode.get(), count);
+	this->codeStream = DataView(stream, streamSize);
+	this->chunkOffsets = std::move(offsets);
+	this->chunksLoaded = std::unique_ptr<bool[]>(new bool[chunkCount]());
+
+	return resultSuccess();
+}
+
+inline ResultInfo Module::loadFunctions(const Byte * data, const ModuleSection & section)
+{
+	if ((section.size % sizeof(ModuleFunction)) != 0)
+		return resultError("Module section malformed");
+
+	this->functions = getSectionView<ModuleFunction>(data, section);
+
+	std::size_t next = 0;
+
+	for (std::size_t index = 0; index < this->functions.getCount(); ++index)
+	{
+		const ModuleFunction & function = this->functions[index];
+
+		if ((function.address < next) || (function.count == 0))
+			return resultError("Module function index malformed");
+
+		next = (static_cast<std::size_t>(function.address) + function.count);
+	}
+
+	return resultSuccess();
+}
+
+inline void Module::prepareLazyCode(void)
+{
+	const std::size_t functionCount = this->functions.getCount();
+	const std::size_t count = this->code.getCount();
+
+	this->functionStates = std::unique_ptr<FunctionState[]>(new FunctionState[functionCount]);
+
+	for (std::size_t index = 0; index < functionCount; ++index)
+		this->functionStates[index] = FunctionState::Pending;
+
+	this->callableAddresses = std::unique_ptr<std::uint32_t[]>(new std::uint32_t[(count + 31) / 32]());
+}
+
+inline std::size_t Module::findFunction(Address address) const
+{
+	// The last function that starts at or before address
+	std::size_t low = 0;
+	std::size_t high = this->functions.getCount();
+
+	while (low < high)
+	{
+		const std::size_t middle = (low + ((high - low) / 2));
+
+		if (this->functions[middle].address <= address)
+			low = (middle + 1);
+		else
+			high = middle;
+	}
+
+	if (low == 0)
+		return this->functions.getCount();
+
+	const ModuleFunction & function = this->functions[low - 1];
+
+	return ((address - function.address) < function.count) ? (low - 1) : this->functions.getCount();
+}
+
+inline bool Module::loadChunks(std::size_t first, std::size_t count) const
+{
+	constexpr std::size_t ChunkInstructions = (CompressionChunkSize / sizeof(Instruction));
+
+	if (count == 0)
+		return true;
+
+	const std::size_t total = this->code.getCount();
+	const std::size_t last = ((first + count - 1) / ChunkInstructions);
+
+	for (std::size_t chunk = (first / ChunkInstructions); chunk <= last; ++chunk)
+	{
+		if (this->chunksLoaded[chunk])
+			continue;
+
+		const std::size_t start = (chunk * ChunkInstructions);
+		const std::size_t size = ((total - start) < ChunkInstructions) ? (total - start) : ChunkInstructions;
+		const std::size_t offset = (this->chunkOffsets[chunk] + sizeof(std::uint32_t));
+
+		Byte * output = reinterpret_cast<Byte *>(&this->decompressedCode[start]);
+
+		if (!decompressChunk(&this->codeStream.getData()[offset], this->chunkOffsets[chunk + 1] - offset, output, size * sizeof(Instruction)))
+			return false;
+
+		if (this->codeSwapped)
+			swapWords(output, size);
+
+		this->chunksLoaded[chunk] = true;
+	}
+
+	return true;
+}
+
+template< typename Check >
+ResultInfo Module::materialize(Address address, Check && check) const
+{
+	if (this->isMaterialized(address))
+		return resultSuccess();
+
+	const std::size_t index = this->findFunction(address);
+
+	if (index == this->functions.getCount())
+		return resultError("Called an address outside any function");
+
+	const ModuleFunction & function = this->functions[index];
+
+	if (this->functionStates[index] == FunctionState::Pending)
+	{
+		if (!this->loadChunks(function.address, function.count))
+		{
+			this->functionStates[index] = FunctionState::Invalid;
+			return resultError("Module code could not be decompressed");
+		}
+
+		const ResultInfo result = check(*this, function);
+
+		this->functionStates[index] = result.isError() ? FunctionState::Invalid : FunctionState::Ready;
+
+		if (result.isError())
+			return result;
+	}
+
+	if (this->functionStates[index] == FunctionState::Invalid)
+		return resultError("Called a function that failed to load");
+
+	this->callableAddresses[address / 32] |= (static_cast<std::uint32_t>(1) << (address % 32));
+
+	return resultSuccess();
+}
+
+inline bool Module::findSymbol(const char * name, ModuleSymbol & symbol) const
+{
+	const std::size_t nameLength = std::strlen(name);
+	const Byte * data = this->symbols.getData();
+	const std::size_t size = this->symbols.getCount();
+
+	for (std::size_t offset = 0; (size - offset) >= sizeof(ModuleSymbol); )
+	{
+		ModuleSymbol entry;
+		std::memcpy(&entry, &data[offset], sizeof(entry));
+
+		offset += sizeof(ModuleSymbol);
+
+		if (entry.nameLength > (size - offset))
+			return false;
+
+		if ((entry.nameLength == nameLength) && (std::memcmp(&data[offset], name, nameLength) == 0))
+		{
+			symbol = entry;
+			return true;
+		}
+
+		// Names are padded to keep the entries aligned
+		const std::size_t paddedLength = ((entry.nameLength + (sizeof(Word) - 1)) & ~(sizeof(Word) - 1));
+
+		if (paddedLength > (size - offset))
+			return false;
+
+		offset += paddedLength;
+	}
+
+	return false;
+}
@@ -0,0 +1,410 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Instruction.h"
+#include "Module.h"
+#include "Compression.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+//
+// Collects the sections of a module and writes them out in the format Module reads.
+// Sections that are left empty are left out.
+// The code section can optionally be compressed (see Compression.h).
+//
+// The builder can also index the functions in the code, which with compression makes the module lazy.
+// Functions start at the entry point and at every Call target, and are joined with their neighbours
+// wherever a jump or falling off the end would cross from one to another,
+// so the index always meets the rules Module sets for lazy modules.
+//
+
+class ModuleBuilder
+{
+private:
+	std::vector<Instruction> code;
+	std::vector<Byte> data;
+	std::vector<std::uint32_t> dataWords;
+	std::vector<Word> constants;
+	std::vector<Byte> symbols;
+	Address entryPoint = 0;
+	bool codeCompressed = false;
+	bool functionsIndexed = false;
+
+public:
+	std::vector<Instruction> & getCode(void)
+	{
+		return this->code;
+	}
+
+	const std::vector<Instruction> & getCode(void) const
+	{
+		return this->code;
+	}
+
+	std::vector<Byte> & getData(void)
+	{
+		return this->data;
+	}
+
+	const std::vector<Byte> & getData(void) const
+	{
+		return this->data;
+	}
+
+	// The offsets of the words written into the data,
+	// which a machine of the other byte order has to swap
+	std::vector<std::uint32_t> & getDataWords(void)
+	{
+		return this->dataWords;
+	}
+
+	const std::vector<std::uint32_t> & getDataWords(void) const
+	{
+		return this->dataWords;
+	}
+
+	std::vector<Word> & getConstants(void)
+	{
+		return this->constants;
+	}
+
+	const std::vector<Word> & getConstants(void) const
+	{
+		return this->constants;
+	}
+
+	Address getEntryPoint(void) const
+	{
+		return this->entryPoint;
+	}
+
+	void setEntryPoint(Address entryPoint)
+	{
+		this->entryPoint = entryPoint;
+	}
+
+	bool isCodeCompressed(void) const
+	{
+		return this->codeCompressed;
+	}
+
+	void setCodeCompressed(bool codeCompressed)
+	{
+		this->codeCompressed = codeCompressed;
+	}
+
+	bool isFunctionsIndexed(void) const
+	{
+		return this->functionsIndexed;
+	}
+
+	void setFunctionsIndexed(bool functionsIndexed)
+	{
+		this->functionsIndexed = functionsIndexed;
+	}
+
+	// O(N log N)
+	std::vector<ModuleFunction> getFunctions(void) const;
+
+	void addSymbol(const char * name, std::size_t nameLength, ModuleSectionType section, std::uint32_t value)
+	{
+		ModuleSymbol symbol;
+		symbol.value = value;
+		symbol.section = section;
+		symbol.nameLength = static_cast<std::uint32_t>(nameLength);
+
+		const Byte * symbolBytes = reinterpret_cast<const Byte *>(&symbol);
+		this->symbols.insert(this->symbols.end(), symbolBytes, symbolBytes + sizeof(symbol));
+		this->symbols.insert(this->symbols.end(), name, name + nameLength);
+		this->symbols.resize(alignSize(this->symbols.size()), 0);
+	}
+
+	// The whole module, as a file would hold it
+	std::vector<Byte> build(void) const;
+
+	// Returns false if the file couldn't be written
+	bool writeFile(const char * path) const
+	{
+		const std::vector<Byte> output = this->build();
+
+		std::FILE * file = std::fopen(path, "wb");
+
+		if (file == nullptr)
+			return false;
+
+		const bool written = (std::fwrite(output.data(), 1, output.size(), file) == output.size());
+
+		return (std::fclose(file) == 0) && written;
+	}
+
+private:
+	static std::size_t alignSize(std::size_t size)
+	{
+		return ((size + (sizeof(Word) - 1)) & ~(sizeof(Word) - 1));
+	}
+
+	std::uint32_t getSectionCount(void) const
+	{
+		return (this->code.empty() ? 0 : 1) + (this->data.empty() ? 0 : 1) + (this->constants.empty() ? 0 : 1) + (this->symbols.empty() ? 0 : 1) + ((this->functionsIndexed && !this->code.empty()) ? 1 : 0) + (this->dataWords.empty() ? 0 : 1);
+	}
+
+	// Decodes the instruction at index, taking in any Extend that precedes it.
+	// Returns the index of the last instruction used.
+	std::size_t decode(std::size_t index, Opcode & opcode, Word & operand) const;
+};
+
+//
+// Definition
+//
+
+inline std::vector<Byte> ModuleBuilder::build(void) const
+{
+	const std::uint32_t sectionCount = this->getSectionCount();
+
+	// Compressed code is the instruction count followed by the stream
+	std::vector<Byte> compressedCode;
+
+	if (this->codeCompressed && !this->code.empty())
+	{
+		const std::uint32_t count = static_cast<std::uint32_t>(this->code.size());
+		const Byte * countBytes = reinterpret_cast<const Byte *>(&count);
+
+		compressedCode.insert(compressedCode.end(), countBytes, countBytes + sizeof(count));
+		compress(reinterpret_cast<const Byte *>(this->code.data()), this->code.size() * sizeof(Instruction), compressedCode);
+	}
+
+	const std::vector<ModuleFunction> functions = this->functionsIndexed ? this->getFunctions() : std::vector<ModuleFunction>();
+
+	std::size_t moduleSize = sizeof(ModuleHeader) + (sectionCount * sizeof(ModuleSection));
+
+	moduleSize += alignSize(this->codeCompressed ? compressedCode.size() : (this->code.size() * sizeof(Instruction)));
+	moduleSize += alignSize(this->data.size());
+	moduleSize += alignSize(this->constants.size() * sizeof(Word));
+	moduleSize += alignSize(this->symbols.size());
+	moduleSize += alignSize(functions.size() * sizeof(ModuleFunction));
+	moduleSize += alignSize(this->dataWords.size() * sizeof(std::uint32_t));
+
+	std::vector<Byte> output(moduleSize);
+
+	ModuleHeader header;
+	header.magic = ModuleHeader::Magic;
+	header.version = ModuleHeader::CurrentVersion;
+	header.flags = 0;
+	header.sectionCount = sectionCount;
+	header.entryPoint = this->entryPoint;
+
+	std::memcpy(output.data(), &header, sizeof(header));
+
+	Byte * table = &output[sizeof(ModuleHeader)];
+	std::size_t offset = sizeof(ModuleHeader) + (sectionCount * sizeof(ModuleSection));
+
+	const auto writeSection = [&](ModuleSectionType type, std::uint32_t flags, const void * contents, std::size_t size)
+	{
+		if (size == 0)
+			return;
+
+		ModuleSection section;
+		section.type = type;
+		section.flags = flags;
+		section.offset = static_cast<std::uint32_t>(offset);
+		section.size = static_cast<std::uint32_t>(size);
+
+		std::memcpy(table, &section, sizeof(section));
+		table += sizeof(section);
+
+		std::memcpy(output.data() + offset, contents, size);
+		std::memset(output.data() + offset + size, 0, alignSize(size) - size);
+		offset += alignSize(size);
+	};
+
+	if (this->codeCompressed)
+		writeSection(ModuleSectionType::Code, ModuleSection::CompressedFlag, compressedCode.data(), compressedCode.size());
+	else
+		writeSection(ModuleSectionType::Code, 0, this->code.data(), this->code.size() * sizeof(Instruction));
+
+	writeSection(ModuleSectionType::Data, 0, this->data.data(), this->data.size());
+	writeSection(ModuleSectionType::Constants, 0, this->constants.data(), this->constants.size() * sizeof(Word));
+	writeSection(ModuleSectionType::Symbols, 0, this->symbols.data(), this->symbols.size());
+	writeSection(ModuleSectionType::Functions, 0, functions.data(), functions.size() * sizeof(ModuleFunction));
+	writeSection(ModuleSectionType::DataWords, 0, this->dataWords.data(), this->dataWords.size() * sizeof(std::uint32_t));
+
+	return output;
+}
+
+inline std::size_t ModuleBuilder::decode(std::size_t index, Opcode & opcode, Word & operand) const
+{
+	const Instruction instruction = this->code[index];
+
+	opcode = instruction.getOpcode();
+	operand = instruction.getOperand();
+
+	if ((opcode != Opcode::Extend) || ((index + 1) >= this->code.size()))
+		return index;
+
+	const Instruction extended = this->code[index + 1];
+
+	opcode = extended.getOpcode();
+	operand = ((operand << 24) | extended.getOperand());
+
+	return (index + 1);
+}
+
+inline std::vector<ModuleFunction> ModuleBuilder::getFunctions(void) const
+{
+	const std::size_t count = this->code.size();
+
+	if (count == 0)
+		return std::vector<ModuleFunction>();
+
+	// Every instruction that a Call can reach starts a function
+	std::vector<std::size_t> starts { 0 };
+
+	if (this->entryPoint < count)
+		starts.push_back(this->entryPoint);
+
+	for (std::size_t index = 0; index < count; ++index)
+	{
+		Opcode opcode;
+		Word operand;
+		index = this->decode(index, opcode, operand);
+
+		if ((opcode == Opcode::Call) && (operand < count))
+			starts.push_back(operand);
+	}
+
+	std::sort(starts.begin(), starts.end());
+	starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+	const auto findPart = [&starts](std::size_t index)
+	{
+		return static_cast<std::size_t>(std::upper_bound(starts.begin(), starts.end(), index) - starts.begin()) - 1;
+	};
+
+	// joins[part] counts the joins that cover the boundary after part
+	std::vector<std::ptrdiff_t> joins(starts.size() + 1, 0);
+
+	const auto join = [&joins](std::size_t first, std::size_t last)
+	{
+		if (first == last)
+			return;
+
+		++joins[std::min(first, last)];
+		--joins[std::max(first, last)];
+	};
+
+	std::size_t part = 0;
+
+	for (std::size_t index = 0; index < count; ++index)
+	{
+		const std::size_t first = index;
+
+		Opcode opcode;
+		Word operand;
+		index = this->decode(index, opcode, operand);
+
+		while (((part + 1) < starts.size()) && (first >= starts[part + 1]))
+			++part;
+
+		const std::size_t end = ((part + 1) < starts.size()) ? starts[part + 1] : count;
+
+		// An Extend pair split between two parts
+		if (index >= end)
+			join(part, part + 1);
+
+		if (opcode == Opcode::JumpAbsolute)
+		{
+			if (operand < count)
+				join(part, findPart(operand));
+		}
+		else if (opcode == Opcode::JumpRelative)
+		{
+			const SWord offset = (index == first) ? this->code[index].getSignedOperand() : static_cast<SWord>(operand);
+			const std::int64_t target = (static_cast<std::int64_t>(index) + 1 + offset);
+
+			if ((target >= 0) && (target < static_cast<std::int64_t>(count)))
+				join(part, findPart(static_cast<std::size_t>(target)));
+		}
+
+		// Running off the end of a part into the next
+		if (((index + 1) == end) && ((part + 1) < starts.size()))
+		{
+			switch (opcode)
+			{
+			case Opcode::End:
+			case Opcode::Return:
+			case Opcode::JumpAbsolute:
+			case Opcode::JumpRelative:
+				break;
+
+			default:
+				join(part, part + 1);
+				break;
+			}
+		}
+	}
+
+	std::vector<ModuleFunction> functions;
+	std::ptrdiff_t covering = 0;
+
+	for (std::size_t index = 0; index < starts.size(); ++index)
+	{
+		if ((index == 0) || (covering == 0))
+			functions.push_back(ModuleFunction { static_cast<std::uint32_t>(starts[index]), 0 });
+
+		covering += joins[index];
+
+		const std::size_t end = ((index + 1) < starts.size()) ? starts[index + 1] : count;
+		functions.back().count = static_cast<std::uint32_t>(end - functions.back().address);
+	}
+
+	// Nothing follows the last function, so anything after its last terminator
+	// is either unreachable or would run off the end of the code regardless
+	ModuleFunction & last = functions.back();
+	std::size_t lastEnd = 0;
+
+	for (std::size_t index = last.address; index < count; ++index)
+	{
+		Opcode opcode;
+		Word operand;
+		index = this->decode(index, opcode, operand);
+
+		switch (opcode)
+		{
+		case Opcode::End:
+		case Opcode::Return:
+		case Opcode::JumpAbsolute:
+		case Opcode::JumpRelative:
+			lastEnd = (index + 1);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (lastEnd > last.address)
+		last.count = static_cast<std::uint32_t>(lastEnd - last.address);
+
+	return functions;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "Utility.h"
+#include "LanguageTypes.h"
+#include "ResultInfo.h"
+
+//
+// A host function callable through CallNative.
+// The input and output counts describe the function's stack effect,
+// which the processor checks before the handler is invoked,
+// so handlers can manipulate the data stack without further checks.
+//
+
+template< typename Environment, typename ProcessorState >
+class NativeFunction
+{
+public:
+	using EnvironmentType = Environment;
+	using ProcessorStateType = ProcessorState;
+
+	using HandlerType = ResultInfo(*)(EnvironmentType &, ProcessorStateType &);
+
+private:
+	HandlerType handler = nullptr;
+	std::size_t inputCount = 0;
+	std::size_t outputCount = 0;
+
+public:
+	constexpr NativeFunction(void) = default;
+
+	constexpr NativeFunction(HandlerType handler, std::size_t inputCount, std::size_t outputCount)
+		: handler(handler), inputCount(inputCount), outputCount(outputCount)
+	{
+	}
+
+	constexpr HandlerType getHandler(void) const
+	{
+		return this->handler;
+	}
+
+	constexpr std::size_t getInputCount(void) const
+	{
+		return this->inputCount;
+	}
+
+	constexpr std::size_t getOutputCount(void) const
+	{
+		return this->outputCount;
+	}
+
+	ResultInfo invoke(EnvironmentType & environment, ProcessorStateType & state) const
+	{
+		return this->handler(environment, state);
+	}
+};
+
+//
+// Adapts an ordinary host function to a NativeFunction at compile time.
+// Arguments are taken from the data stack (deepest first),
+// and a non-void result is pushed back onto the data stack.
+//
+// E.g. NativeThunk<decltype(&hash), &hash>
+//
+
+template< typename Signature, Signature function >
+struct NativeThunk;
+
+template< typename Result, typename ... Arguments, Result (*function)(Arguments...) >
+struct NativeThunk<Result (*)(Arguments...), function>
+{
+	static constexpr std::size_t InputCount = sizeof...(Arguments);
+	static constexpr std::size_t OutputCount = 1;
+
+	template< typename Environment, typename ProcessorState >
+	static ResultInfo invoke(Environment & environment, ProcessorState & state)
+	{
+		(void)environment;
+
+		auto & stack = state.getDataStack();
+
+		const Word result = invokeImplementation(stack, std::make_index_sequence<InputCount>());
+
+		for (std::size_t i = 0; i < InputCount; ++i)
+			stack.drop();
+
+		stack.push(result);
+
+		return resultSuccess();
+	}
+
+	template< typename Environment, typename ProcessorState >
+	static constexpr NativeFunction<Environment, ProcessorState> create(void)
+	{
+		return NativeFunction<Environment, ProcessorState>(&invoke<Environment, ProcessorState>, InputCount, OutputCount);
+	}
+
+private:
+	template< typename Stack, std::size_t ... Indices >
+	static Word invokeImplementation(Stack & stack, std::index_sequence<Indices...>)
+	{
+		const auto base = stack.getCount() - InputCount;
+		(void)base;
+
+		return static_cast<Word>(function(static_cast<Arguments>(stack[base + Indices])...));
+	}
+};
+
+template< typename ... Arguments, void (*function)(Arguments...) >
+struct NativeThunk<void (*)(Arguments...), function>
+{
+	static constexpr std::size_t InputCount = sizeof...(Arguments);
+	static constexpr std::size_t OutputCount = 0;
+
+	template< typename Environment, typename ProcessorState >
+	static ResultInfo invoke(Environment & environment, ProcessorState & state)
+	{
+		(void)environment;
+
+		auto & stack = state.getDataStack();
+
+		invokeImplementation(stack, std::make_index_sequence<InputCount>());
+
+		for (std::size_t i = 0; i < InputCount; ++i)
+			stack.drop();
+
+		return resultSuccess();
+	}
+
+	template< typename Environment, typename ProcessorState >
+	static constexpr NativeFunction<Environment, ProcessorState> create(void)
+	{
+		return NativeFunction<Environment, ProcessorState>(&invoke<Environment, ProcessorState>, InputCount, OutputCount);
+	}
+
+private:
+	template< typename Stack, std::size_t ... Indices >
+	static void invokeImplementation(Stack & stack, std::index_sequence<Indices...>)
+	{
+		const auto base = stack.getCount() - InputCount;
+		(void)base;
+
+		function(static_cast<Arguments>(stack[base + Indices])...);
+	}
+};
@@ -28,6 +28,7 @@ enum class Opcode : std::uint8_t
 	PrintChar = 0x04,
 	PrintLine = 0x05,
 	PrintStack = 0x06,
+	Extend = 0x07,
 
 	// Category 1 - Stack Manipulation
 	Push = 0x10,
@@ -38,6 +39,7 @@ enum class Opcode : std::uint8_t
 	Swap = 0x15,
 	Rotate = 0x16, 
 	Over = 0x17, 
+	PushConstant = 0x18,
 
 	// DUP = PICK(0)
 	// OVER = PICK(1)
@@ -50,6 +52,7 @@ enum class Opcode : std::uint8_t
 	Return = 0x22,
 	JumpRelative = 0x23,
 	JumpAbsolute = 0x24,
+	CallNative = 0x25,
 
 	// Category 3 - Arithmetic
 	Add = 0x30,
@@ -98,4 +101,8 @@ enum class Opcode : std::uint8_t
 	Realloc = 0x74,
 	ReallocImmediate = 0x75,
 	Free = 0x76,
+	ArenaCreate = 0x77,
+	ArenaAlloc = 0x78,
+	ArenaReset = 0x79,
+	ArenaDestroy = 0x7A,
 };
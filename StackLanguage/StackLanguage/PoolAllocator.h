@@ -0,0 +1,297 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "AllocationStatistics.h"
+
+//
+// A segregated-fit allocator for the many small blocks that programs tend to allocate.
+//
+// Requests of up to LargestPooledSize bytes are rounded up to a multiple of Granularity
+// and taken from a per-size free list. Empty lists are refilled by carving a slab
+// obtained from the memory's heap. Larger requests go straight to the memory's heap.
+//
+// Every block is preceded by a header word holding its size,
+// with PooledFlag set for pooled blocks and FreeFlag set while a pooled block is free.
+// Free pooled blocks hold the address of the next free block of the same size.
+//
+// All bookkeeping goes through the memory's load/store functions,
+// so a program that scribbles over headers can only corrupt its own memory.
+//
+
+class PoolAllocator
+{
+public:
+	static constexpr bool IsCollecting = false;
+
+	static constexpr Word Granularity = 8;
+	static constexpr std::size_t ClassCount = 8;
+	static constexpr Word LargestPooledSize = (Granularity * ClassCount);
+	static constexpr Word SlabSize = 4096;
+
+private:
+	static constexpr Word HeaderSize = sizeof(Word);
+	static constexpr Word PooledFlag = 0x1;
+	static constexpr Word FreeFlag = 0x2;
+	static constexpr Word SizeMask = ~static_cast<Word>(sizeof(Word) - 1);
+
+private:
+	Address freeLists[ClassCount] = {};
+	std::size_t slabCount = 0;
+	AllocationStatistics statistics;
+
+public:
+	const AllocationStatistics & getStatistics(void) const
+	{
+		return this->statistics;
+	}
+
+	std::size_t getSlabCount(void) const
+	{
+		return this->slabCount;
+	}
+
+	template< typename Memory >
+	Address allocate(Memory & memory, Word size);
+
+	template< typename Memory >
+	Address allocateZeroed(Memory & memory, Word count, Word size);
+
+	template< typename Memory >
+	Address reallocate(Memory & memory, Address address, Word size);
+
+	template< typename Memory >
+	bool deallocate(Memory & memory, Address address);
+
+private:
+	static constexpr std::size_t getClassIndex(Word size)
+	{
+		return (size == 0) ? 0 : ((size - 1) / Granularity);
+	}
+
+	static constexpr Word getClassSize(std::size_t index)
+	{
+		return static_cast<Word>((index + 1) * Granularity);
+	}
+
+	// Returns 0 if address doesn't look like a live block
+	template< typename Memory >
+	static Word readHeader(const Memory & memory, Address address, Word & header)
+	{
+		if ((address < HeaderSize) || !memory.loadWord(address - HeaderSize, header))
+			return 0;
+
+		if ((header & PooledFlag) == 0)
+			return (header & SizeMask);
+
+		const Word size = (header & SizeMask);
+
+		if (((header & FreeFlag) != 0) || (size == 0) || (size > LargestPooledSize) || ((size % Granularity) != 0))
+			return 0;
+
+		return size;
+	}
+
+	template< typename Memory >
+	bool refill(Memory & memory, std::size_t index);
+
+	template< typename Memory >
+	static void zero(Memory & memory, Address address, Word size)
+	{
+		for (Word offset = 0; offset < size; offset += sizeof(Word))
+			memory.storeWord(address + offset, 0);
+	}
+};
+
+//
+// Definition
+//
+
+template< typename Memory >
+Address PoolAllocator::allocate(Memory & memory, Word size)
+{
+	if (size <= LargestPooledSize)
+	{
+		const std::size_t index = getClassIndex(size);
+
+		if ((this->freeLists[index] == 0) && !this->refill(memory, index))
+			return 0;
+
+		const Address result = this->freeLists[index];
+
+		Word next;
+		if (!memory.loadWord(result, next))
+		{
+			this->freeLists[index] = 0;
+			return 0;
+		}
+
+		this->freeLists[index] = next;
+
+		const Word classSize = getClassSize(index);
+		memory.storeWord(result - HeaderSize, classSize | PooledFlag);
+
+		this->statistics.recordAllocation(classSize);
+		return result;
+	}
+
+	if (size > (~static_cast<Word>(0) - (HeaderSize * 2)))
+		return 0;
+
+	const Word blockSize = ((size + (sizeof(Word) - 1)) & SizeMask);
+	const Address block = memory.allocate(blockSize + HeaderSize);
+
+	if (block == 0)
+		return 0;
+
+	memory.storeWord(block, blockSize);
+
+	this->statistics.recordAllocation(blockSize);
+	return (block + HeaderSize);
+}
+
+template< typename Memory >
+Address PoolAllocator::allocateZeroed(Memory & memory, Word count, Word size)
+{
+	const std::uint64_t total = (static_cast<std::uint64_t>(count) * size);
+
+	if (total > ~static_cast<Word>(0))
+		return 0;
+
+	const Address result = this->allocate(memory, static_cast<Word>(total));
+
+	if (result != 0)
+		zero(memory, result, static_cast<Word>(total));
+
+	return result;
+}
+
+template< typename Memory >
+Address PoolAllocator::reallocate(Memory & memory, Address address, Word size)
+{
+	if (address == 0)
+		return this->allocate(memory, size);
+
+	Word header;
+	const Word currentSize = readHeader(memory, address, header);
+
+	if (currentSize == 0)
+		return 0;
+
+	if (size <= currentSize)
+		return address;
+
+	// Large blocks can be grown by the heap, possibly in place
+	if (((header & PooledFlag) == 0) && (size > LargestPooledSize))
+	{
+		if (size > (~static_cast<Word>(0) - (HeaderSize * 2)))
+			return 0;
+
+		const Word blockSize = ((size + (sizeof(Word) - 1)) & SizeMask);
+		const Address block = memory.reallocate(address - HeaderSize, blockSize + HeaderSize);
+
+		if (block == 0)
+			return 0;
+
+		memory.storeWord(block, blockSize);
+
+		this->statistics.recordDeallocation(currentSize);
+		this->statistics.recordAllocation(blockSize);
+		return (block + HeaderSize);
+	}
+
+	const Address result = this->allocate(memory, size);
+
+	if (result == 0)
+		return 0;
+
+	for (Word offset = 0; offset < currentSize; offset += sizeof(Word))
+	{
+		Word value;
+		memory.loadWord(address + offset, value);
+		memory.storeWord(result + offset, value);
+	}
+
+	this->deallocate(memory, address);
+
+	return result;
+}
+
+template< typename Memory >
+bool PoolAllocator::deallocate(Memory & memory, Address address)
+{
+	if (address == 0)
+		return true;
+
+	Word header;
+	const Word size = readHeader(memory, address, header);
+
+	if (size == 0)
+		return false;
+
+	if ((header & PooledFlag) == 0)
+	{
+		if (!memory.deallocate(address - HeaderSize))
+			return false;
+
+		this->statistics.recordDeallocation(size);
+		return true;
+	}
+
+	const std::size_t index = getClassIndex(size);
+
+	memory.storeWord(address - HeaderSize, header | FreeFlag);
+	memory.storeWord(address, this->freeLists[index]);
+	this->freeLists[index] = address;
+
+	this->statistics.recordDeallocation(size);
+	return true;
+}
+
+template< typename Memory >
+bool PoolAllocator::refill(Memory & memory, std::size_t index)
+{
+	const Address slab = memory.allocate(SlabSize);
+
+	if (slab == 0)
+		return false;
+
+	++this->slabCount;
+
+	const Word classSize = getClassSize(index);
+	const Word stride = (classSize + HeaderSize);
+
+	// Thread the slab's blocks together, lowest address first
+	Address next = 0;
+	for (Word offset = (((SlabSize / stride) - 1) * stride); ; offset -= stride)
+	{
+		const Address block = (slab + offset + HeaderSize);
+
+		memory.storeWord(block - HeaderSize, classSize | PooledFlag | FreeFlag);
+		memory.storeWord(block, next);
+		next = block;
+
+		if (offset == 0)
+			break;
+	}
+
+	this->freeLists[index] = next;
+
+	return true;
+}
@@ -16,13 +16,28 @@
 //   limitations under the License.
 //
 
+#include "StdInt.h"
 #include "Utility.h"
 
+// The bases that integers can be printed in, as given to PrintInt
+enum class NumberBase
+{
+	Binary = 2,
+	Decimal = 10,
+	Hexadecimal = 16,
+};
+
 //
 // Mocks inheritance at compile time.
 // Attempts to look for print and printLine functions on printer.
 // If it can't find a suitable overload, it uses its own function definitions.
 //
+// Integers are formatted here unless the printer formats them itself.
+// Decimal digits are produced two at a time from a table, and each number
+// is passed on as a single string, so a printer with print(const char *, std::size_t)
+// receives it as one copy into its buffer.
+// print(value, NumberBase) prints an unsigned value in binary, decimal or lowercase hexadecimal.
+//
 
 template< typename Printer >
 class PrinterDecorator
@@ -42,7 +57,8 @@ public:
 	template< std::size_t size >
 	void print(const char (&array)[size])
 	{
-		this->print(&array[0], size);
+		// String literals include their null terminator
+		this->print(&array[0], ((size > 0) && (array[size - 1] == '\0')) ? (size - 1) : size);
 	}
 
 	template< std::size_t size >
@@ -132,7 +148,19 @@ private:
 
 	void printImplementation(signed long long value)
 	{
-		(void)value;
+		// Negated as unsigned so that the lowest value doesn't overflow
+		const unsigned long long magnitude = (value < 0) ? (0ull - static_cast<unsigned long long>(value)) : static_cast<unsigned long long>(value);
+
+		char digits[DecimalDigitsMaximum + 1];
+		std::size_t index = formatDecimal(magnitude, digits, DecimalDigitsMaximum + 1);
+
+		if (value < 0)
+		{
+			--index;
+			digits[index] = '-';
+		}
+
+		this->print(&digits[index], (DecimalDigitsMaximum + 1) - index);
 	}
 
 	void printImplementation(unsigned char value)
@@ -157,7 +185,107 @@ private:
 
 	void printImplementation(unsigned long long value)
 	{
-		(void)value;
+		char digits[DecimalDigitsMaximum];
+		const std::size_t index = formatDecimal(value, digits, DecimalDigitsMaximum);
+
+		this->print(&digits[index], DecimalDigitsMaximum - index);
+	}
+
+	void printImplementation(unsigned long long value, NumberBase base)
+	{
+		switch (base)
+		{
+		case NumberBase::Binary:
+			this->printPowerOfTwo<1>(value);
+			break;
+
+		case NumberBase::Hexadecimal:
+			this->printPowerOfTwo<4>(value);
+			break;
+
+		default:
+			this->printImplementation(value);
+			break;
+		}
+	}
+
+	//
+	// Integer formatting
+	//
+
+	static constexpr std::size_t DecimalDigitsMaximum = 20;
+	static constexpr std::size_t BinaryDigitsMaximum = 64;
+
+	// "00" to "99"
+	static const char * getDigitPairs(void)
+	{
+		static const char digitPairs[] =
+			"00010203040506070809"
+			"10111213141516171819"
+			"20212223242526272829"
+			"30313233343536373839"
+			"40414243444546474849"
+			"50515253545556575859"
+			"60616263646566676869"
+			"70717273747576777879"
+			"80818283848586878889"
+			"90919293949596979899";
+
+		return digitPairs;
+	}
+
+	// Writes the digits of value to the end of digits, which holds size characters.
+	// Returns the index of the first digit.
+	static std::size_t formatDecimal(unsigned long long value, char * digits, std::size_t size)
+	{
+		const char * digitPairs = getDigitPairs();
+		std::size_t index = size;
+
+		while (value >= 100)
+		{
+			const std::size_t pair = static_cast<std::size_t>(value % 100) * 2;
+			value /= 100;
+
+			index -= 2;
+			digits[index] = digitPairs[pair];
+			digits[index + 1] = digitPairs[pair + 1];
+		}
+
+		if (value >= 10)
+		{
+			const std::size_t pair = static_cast<std::size_t>(value) * 2;
+
+			index -= 2;
+			digits[index] = digitPairs[pair];
+			digits[index + 1] = digitPairs[pair + 1];
+		}
+		else
+		{
+			--index;
+			digits[index] = static_cast<char>('0' + value);
+		}
+
+		return index;
+	}
+
+	// Bits is the number of bits per digit
+	template< unsigned Bits >
+	void printPowerOfTwo(unsigned long long value)
+	{
+		constexpr unsigned long long mask = ((1ull << Bits) - 1);
+
+		char digits[BinaryDigitsMaximum];
+		std::size_t index = BinaryDigitsMaximum;
+
+		do
+		{
+			--index;
+			digits[index] = "0123456789abcdef"[value & mask];
+			value >>= Bits;
+		}
+		while (value != 0);
+
+		this->print(&digits[index], BinaryDigitsMaximum - index);
 	}
 
 	void printImplementation(float value)
@@ -241,6 +369,19 @@ private:
 		printLineImplementation();
 	}
 
+	template< typename C >
+	auto flushDisambiguate(StrongMatch)
+		-> decltype(&C::flush, void())
+	{
+		printer.flush();
+	}
+
+	template< typename C >
+	void flushDisambiguate(WeakMatch)
+	{
+		// Printers without a flush write straight through
+	}
+
 public:
 	template< typename T >
 	auto print(T value)
@@ -268,4 +409,10 @@ public:
 	{
 		printLineDisambiguate<Printer>(StrongMatch());
 	}
+
+	// Hands any buffered output on, for printers that buffer
+	void flush(void)
+	{
+		flushDisambiguate<Printer>(StrongMatch());
+	}
 };
\ No newline at end of file
@@ -20,8 +20,18 @@
 #include "Instruction.h"
 #include "LanguageTypes.h"
 #include "Environment.h"
+#include "PrinterDecorator.h"
+#include "Module.h"
+#include "Verifier.h"
 #include "ProcessorState.h"
+#include "NativeFunction.h"
+#include "Arena.h"
+#include "AllocationStatistics.h"
 #include "ResultInfo.h"
+#include "List.h"
+#include "Utility.h"
+
+#include <limits>
 
 template< typename Settings >
 class Processor
@@ -33,14 +43,47 @@ public:
 	using ProcessorStateSettingsType = typename SettingsType::ProcessorStateSettingsType;
 
 	using EnvironmentType = Environment<EnvironmentSettingsType>;
-	using ProcessorStateType = ProcessorState<ProcessorStateSettingsType>;
+	using ProcessorStateType = typename SettingsType::template ProcessorStateTemplate<ProcessorStateSettingsType>;
+
+	using MemoryType = typename SettingsType::MemoryType;
+	using AllocatorType = typename SettingsType::AllocatorType;
 
 	using BreakHandlerType = void(*)(const EnvironmentType &, const ProcessorStateType &);
 
+	static constexpr std::size_t NativeFunctionListSize = SettingsType::NativeFunctionListSize;
+	static constexpr std::size_t ArenaCount = SettingsType::ArenaCount;
+
+	using NativeFunctionType = NativeFunction<EnvironmentType, ProcessorStateType>;
+	using NativeHandlerType = typename NativeFunctionType::HandlerType;
+	using NativeFunctionListType = List<NativeFunctionType, NativeFunctionListSize>;
+
+	// Everything a running program can change.
+	// The environment, native functions and quota are configuration and aren't captured.
+	struct Snapshot
+	{
+		ProcessorStateType state;
+		typename MemoryType::Snapshot memory;
+		AllocatorType allocator;
+		Arena arenas[ArenaCount];
+		bool running;
+		bool completed;
+	};
+
 private:
 	EnvironmentType environment;
 	ProcessorStateType state;
 	BreakHandlerType breakHandler;
+	NativeFunctionListType nativeFunctions;
+	MemoryType memory;
+	AllocatorType allocator;
+	Arena arenas[ArenaCount];
+	std::size_t memoryQuota = SettingsType::MemoryQuota;
+
+	// Where the instruction being executed starts
+	Address instructionAddress = 0;
+
+	// Set while running a lazy module, whose functions are materialised as they are called
+	const Module * lazyModule = nullptr;
 
 	bool running = false;
 	bool completed = false;
@@ -77,13 +120,185 @@ public:
 		this->running = false;
 	}
 
+	// Registers a handler that manipulates the state directly.
+	// The handler may assume that inputCount words are on the data stack
+	// and that there is room for outputCount words once they are removed.
+	bool addNativeFunction(NativeHandlerType handler, std::size_t inputCount, std::size_t outputCount)
+	{
+		return this->nativeFunctions.add(NativeFunctionType(handler, inputCount, outputCount));
+	}
+
+	// Registers an ordinary host function, e.g. addNativeFunction<decltype(&hash), &hash>()
+	template< typename Signature, Signature function >
+	bool addNativeFunction(void)
+	{
+		return this->nativeFunctions.add(NativeThunk<Signature, function>::template create<EnvironmentType, ProcessorStateType>());
+	}
+
+	const NativeFunctionListType & getNativeFunctions(void) const
+	{
+		return this->nativeFunctions;
+	}
+
+	const ProcessorStateType & getState(void) const
+	{
+		return this->state;
+	}
+
+	// Only available when Settings::StackContainerType is resizable, e.g. GrowableArray
+	void setDataStackCapacity(std::size_t capacity)
+	{
+		this->state.getDataStack().getContainer().setCapacity(capacity);
+	}
+
+	// Only available when Settings::StackContainerType is resizable, e.g. GrowableArray
+	void setReturnStackCapacity(std::size_t capacity)
+	{
+		this->state.getReturnStack().getContainer().setCapacity(capacity);
+	}
+
+	MemoryType & getMemory(void)
+	{
+		return this->memory;
+	}
+
+	const MemoryType & getMemory(void) const
+	{
+		return this->memory;
+	}
+
+	const AllocatorType & getAllocator(void) const
+	{
+		return this->allocator;
+	}
+
+	const AllocationStatistics & getAllocationStatistics(void) const
+	{
+		return this->allocator.getStatistics();
+	}
+
+	std::size_t getMemoryQuota(void) const
+	{
+		return this->memoryQuota;
+	}
+
+	// 0 removes the limit
+	void setMemoryQuota(std::size_t memoryQuota)
+	{
+		this->memoryQuota = memoryQuota;
+	}
+
+	// Captures the processor so that it can be resumed later,
+	// either by this processor or by any other with the same settings.
+	// Capturing copies the memory once, after which restoring is cheap,
+	// see MemoryImage for details.
+	Snapshot createSnapshot(void) const
+	{
+		Snapshot snapshot;
+		snapshot.state = this->state;
+		snapshot.memory = this->memory.createSnapshot();
+		snapshot.allocator = this->allocator;
+		for (std::size_t index = 0; index < ArenaCount; ++index)
+			snapshot.arenas[index] = this->arenas[index];
+		snapshot.running = this->running;
+		snapshot.completed = this->completed;
+		return snapshot;
+	}
+
+	// Returns false if the memory couldn't be restored
+	bool restoreSnapshot(const Snapshot & snapshot)
+	{
+		if (!this->memory.restoreSnapshot(snapshot.memory))
+			return false;
+
+		this->state = snapshot.state;
+		this->allocator = snapshot.allocator;
+		for (std::size_t index = 0; index < ArenaCount; ++index)
+			this->arenas[index] = snapshot.arenas[index];
+		this->running = snapshot.running;
+		this->completed = snapshot.completed;
+		return true;
+	}
+
+	// Copies the module's data into memory and moves to its entry point.
+	// The environment is expected to hold the same module's code and constants.
+	// A lazy module must outlive the processor.
+	ResultInfo loadModule(const Module & module)
+	{
+		if (module.isLazy() && !isIndexedByInstruction(this->environment.getInstructions()))
+			return resultError("Lazy modules need code indexed by instruction");
+
+		const auto data = module.getData();
+
+		if (!this->memory.loadStaticData(data.getData(), data.getCount()))
+			return resultError("Module data could not be loaded");
+
+		this->lazyModule = module.isLazy() ? &module : nullptr;
+
+		if (this->lazyModule != nullptr)
+		{
+			const auto result = this->materialize(module.getEntryPoint());
+
+			if (result.isError())
+				return result;
+		}
+
+		this->state.jumpAbsolute(translateAddress(this->environment.getInstructions(), module.getEntryPoint()));
+
+		return resultSuccess();
+	}
+
+	// Runs a full collection if the allocator is a CollectingAllocator,
+	// otherwise does nothing
+	void collectGarbage(void)
+	{
+		this->collectGarbage(0, IsCollectingType());
+	}
+
 	ResultInfo run(void)
 	{
+		if (!this->memory.isAvailable())
+			return resultError("Memory unavailable");
+
 		this->start();
 
+		ResultInfo result;
+
+		if (!this->memory.runGuarded([this, &result]() { result = this->runCycles(); }))
+			result = this->memoryFault();
+
+		// Output up to an error goes out before the error is reported
+		if (result.isError())
+			this->environment.getPrinter().flush();
+
+		return result;
+	}
+
+	ResultInfo executeCycle(void)
+	{
+		ResultInfo result;
+
+		if (!this->memory.runGuarded([this, &result]() { result = this->executeCycleUnguarded(); }))
+			result = this->memoryFault();
+
+		if (result.isError())
+			this->environment.getPrinter().flush();
+
+		return result;
+	}
+
+private:
+	void complete(void)
+	{
+		this->running = false;
+		this->completed = true;
+	}
+
+	ResultInfo runCycles(void)
+	{
 		while (this->isRunning())
 		{
-			const auto result = this->executeCycle();
+			const auto result = this->executeCycleUnguarded();
 
 			if (result.isError())
 				return result;
@@ -92,7 +307,7 @@ public:
 		return (this->hasCompleted()) ? resultSuccess() : resultError("Error unknown");
 	}
 
-	ResultInfo executeCycle(void)
+	ResultInfo executeCycleUnguarded(void)
 	{
 		if (this->hasCompleted())
 			return resultSuccess();
@@ -100,24 +315,174 @@ public:
 		if (!this->isRunning())
 			return resultError("Processor not running");
 
-		const auto instructionPointer = this->state.getInstructionPointer();
-		auto & instructions = this->environment.getInstructions();
+		this->instructionAddress = this->state.getInstructionPointer();
+
+		Instruction instruction;
 
-		if (instructionPointer >= instructions.getCount())
+		if (!this->fetch(instruction))
 			return resultError("Jumped to invalid address");
 
-		const auto instruction = instructions[instructionPointer];
+		return this->execute(instruction);
+	}
 
-		this->state.incrementInstructionPointer();
+	// Reads the instruction at the instruction pointer and moves past it
+	bool fetch(Instruction & instruction)
+	{
+		Address instructionPointer = this->state.getInstructionPointer();
 
-		return this->execute(instruction);
+		if (!fetchInstruction(this->environment.getInstructions(), instructionPointer, instruction))
+			return false;
+
+		this->state.jumpAbsolute(instructionPointer);
+		return true;
 	}
 
-private:
-	void complete(void)
+	// Every call goes through here, so that a lazy module's functions are materialised
+	// before they run. Anything else costs only the check.
+	ResultInfo callFunction(Address address)
 	{
-		this->running = false;
-		this->completed = true;
+		// A growable or unified return stack can stop short of ReturnStackSize
+		if (this->state.getReturnStack().isFull())
+			return resultError("Call stack overflow");
+
+		if ((this->lazyModule != nullptr) && !this->lazyModule->isMaterialized(address))
+		{
+			const auto result = this->materialize(address);
+
+			if (result.isError())
+				return result;
+		}
+
+		this->state.functionCall(address);
+
+		return resultSuccess();
+	}
+
+	// The slow path of callFunction
+	ResultInfo materialize(Address address)
+	{
+		return this->lazyModule->materialize(address, [](const Module & module, const ModuleFunction & function)
+		{
+			auto verifier = Verifier<SettingsType>();
+			return verifier.verifyFunction(module, function);
+		});
+	}
+
+	// A guarded memory access faulted part way through an instruction.
+	// The instruction pointer is moved back to the faulting instruction.
+	ResultInfo memoryFault(void)
+	{
+		this->stop();
+		this->state.jumpAbsolute(this->instructionAddress);
+		return resultError("Memory access out of bounds");
+	}
+
+	using IsCollectingType = std::integral_constant<bool, AllocatorType::IsCollecting>;
+
+	// Gives a collecting allocator its chance to collect around an allocation.
+	// pinned is an address the instruction has already taken off the stack.
+	template< typename Allocate >
+	Address allocateCollecting(Address pinned, Allocate && allocate)
+	{
+		return this->allocateCollecting(pinned, std::forward<Allocate>(allocate), IsCollectingType());
+	}
+
+	template< typename Allocate >
+	Address allocateCollecting(Address pinned, Allocate && allocate, std::false_type)
+	{
+		(void)pinned;
+		return allocate();
+	}
+
+	template< typename Allocate >
+	Address allocateCollecting(Address pinned, Allocate && allocate, std::true_type)
+	{
+		if (this->allocator.shouldCollect())
+			this->collectGarbage(pinned, std::true_type());
+
+		const Address result = allocate();
+
+		if (result != 0)
+			return result;
+
+		// Reclaim everything possible before giving up
+		this->collectGarbage(pinned, std::true_type());
+		this->allocator.finishSweep(this->memory);
+
+		return allocate();
+	}
+
+	void collectGarbage(Address pinned, std::false_type)
+	{
+		(void)pinned;
+	}
+
+	void collectGarbage(Address pinned, std::true_type)
+	{
+		this->allocator.collect(this->memory, [this, pinned](auto && mark)
+		{
+			mark(pinned);
+
+			// Module globals can hold heap addresses too
+			for (Address address = MemoryType::StaticDataAddress; address < this->memory.getStaticDataEnd(); address += sizeof(Word))
+			{
+				Word word;
+
+				if (this->memory.loadWord(address, word))
+					mark(word);
+			}
+
+			const auto & dataStack = this->state.getDataStack();
+			for (std::size_t index = 0; index < dataStack.getCount(); ++index)
+				mark(dataStack[index]);
+
+			const auto & returnStack = this->state.getReturnStack();
+			for (std::size_t index = 0; index < returnStack.getCount(); ++index)
+				mark(returnStack[index]);
+
+			for (std::size_t index = 0; index < ArenaCount; ++index)
+				mark(this->arenas[index].getChunks());
+		});
+	}
+
+	void reportAllocations(void)
+	{
+		auto & printer = this->environment.getPrinter();
+		const auto & statistics = this->allocator.getStatistics();
+
+		printer.print("<Allocations: ");
+		printer.print(statistics.getAllocationCount());
+		printer.print(", Deallocations: ");
+		printer.print(statistics.getDeallocationCount());
+		printer.print(", Allocated bytes: ");
+		printer.print(statistics.getAllocatedBytes());
+		printer.print(", Peak bytes: ");
+		printer.print(statistics.getPeakBytes());
+		printer.printLine(">");
+
+		if (statistics.getLiveCount() > 0)
+		{
+			printer.print("<Leaked: ");
+			printer.print(statistics.getLiveCount());
+			printer.print(" blocks, ");
+			printer.print(statistics.getLiveBytes());
+			printer.printLine(" bytes>");
+		}
+
+		if (statistics.getCollectionCount() > 0)
+		{
+			printer.print("<Collections: ");
+			printer.print(statistics.getCollectionCount());
+			printer.print(", Reclaimed: ");
+			printer.print(statistics.getReclaimedCount());
+			printer.print(" blocks, ");
+			printer.print(statistics.getReclaimedBytes());
+			printer.print(" bytes, Time: ");
+			printer.print(statistics.getCollectionNanoseconds() / 1000);
+			printer.print("us, Longest pause: ");
+			printer.print(statistics.getLongestPauseNanoseconds() / 1000);
+			printer.printLine("us>");
+		}
 	}
 
 private:
@@ -126,6 +491,23 @@ private:
 
 	ResultInfo assertDataStackSize(std::size_t amount);
 
+	// Checked before each Category 7 allocation with the bytes it asks for and any it gives back,
+	// so an allocation that would break the quota never reaches the allocator
+	ResultInfo assertMemoryQuota(std::size_t requested, std::size_t released);
+
+	// Checked again afterwards, since allocators round sizes up.
+	// Allocations that break the quota are undone where that's possible,
+	// either way the error stops the program.
+	ResultInfo assertMemoryQuota(void);
+	ResultInfo assertMemoryQuota(Address allocation);
+
+	// The bytes Calloc asks for, or the most there can be if that overflows
+	static std::size_t getZeroedSize(Word count, Word size)
+	{
+		const std::uint64_t bytes = (static_cast<std::uint64_t>(count) * size);
+		return (bytes > std::numeric_limits<std::size_t>::max()) ? std::numeric_limits<std::size_t>::max() : static_cast<std::size_t>(bytes);
+	}
+
 	// Category 0 - Basic control
 	ResultInfo executeNop(Instruction instruction);
 	ResultInfo executeEnd(Instruction instruction);
@@ -134,6 +516,13 @@ private:
 	ResultInfo executePrintChar(Instruction instruction);
 	ResultInfo executePrintLine(Instruction instruction);
 	ResultInfo executePrintStack(Instruction instruction);
+	ResultInfo executeExtend(Instruction instruction);
+
+	// The instructions that an Extend can precede, given their full operand
+	ResultInfo executeExtended(Opcode opcode, Word operand);
+
+	template< typename Operation >
+	ResultInfo executeExtendedImmediate(Operation && operation);
 
 	// Category 1 - Stack Manipulation
 	ResultInfo executePush(Instruction instruction);
@@ -144,6 +533,7 @@ private:
 	ResultInfo executeSwap(Instruction instruction);
 	ResultInfo executeRotate(Instruction instruction);
 	ResultInfo executeOver(Instruction instruction);
+	ResultInfo executePushConstant(Instruction instruction);
 
 	// Category 2 - Flow Control
 	ResultInfo executeCall(Instruction instruction);
@@ -151,6 +541,7 @@ private:
 	ResultInfo executeReturn(Instruction instruction);
 	ResultInfo executeJumpRelative(Instruction instruction);
 	ResultInfo executeJumpAbsolute(Instruction instruction);
+	ResultInfo executeCallNative(Instruction instruction);
 
 	// Category 3 - Arithmetic
 	ResultInfo executeAdd(Instruction instruction);
@@ -191,6 +582,13 @@ private:
 	ResultInfo executeRealloc(Instruction instruction);
 	ResultInfo executeReallocImmediate(Instruction instruction);
 	ResultInfo executeFree(Instruction instruction);
+	ResultInfo executeArenaCreate(Instruction instruction);
+	ResultInfo executeArenaAlloc(Instruction instruction);
+	ResultInfo executeArenaReset(Instruction instruction);
+	ResultInfo executeArenaDestroy(Instruction instruction);
+
+	// Arena handles are indices offset by one so that 0 can signal failure
+	Arena * getArena(Word handle);
 };
 
 //
@@ -210,6 +608,7 @@ ResultInfo Processor<Settings>::execute(Instruction instruction)
 	case Opcode::PrintChar: return executePrintChar(instruction);
 	case Opcode::PrintLine: return executePrintLine(instruction);
 	case Opcode::PrintStack: return executePrintStack(instruction);
+	case Opcode::Extend: return executeExtend(instruction);
 
 		// Category 1 - Stack Manipulation
 	case Opcode::Push: return executePush(instruction);
@@ -220,6 +619,7 @@ ResultInfo Processor<Settings>::execute(Instruction instruction)
 	case Opcode::Swap: return executeSwap(instruction);
 	case Opcode::Rotate: return executeRotate(instruction);
 	case Opcode::Over: return executeOver(instruction);
+	case Opcode::PushConstant: return executePushConstant(instruction);
 
 		// Category 2 - Flow Control
 	case Opcode::Call: return executeCall(instruction);
@@ -227,6 +627,7 @@ ResultInfo Processor<Settings>::execute(Instruction instruction)
 	case Opcode::Return: return executeReturn(instruction);
 	case Opcode::JumpRelative: return executeJumpRelative(instruction);
 	case Opcode::JumpAbsolute: return executeJumpAbsolute(instruction);
+	case Opcode::CallNative: return executeCallNative(instruction);
 
 		// Category 3 - Arithmetic
 	case Opcode::Add: return executeAdd(instruction);
@@ -264,7 +665,13 @@ ResultInfo Processor<Settings>::execute(Instruction instruction)
 	case Opcode::MallocImmediate: return executeMallocImmediate(instruction);
 	case Opcode::Calloc: return executeCalloc(instruction);
 	case Opcode::CallocImmediate: return executeCallocImmediate(instruction);
+	case Opcode::Realloc: return executeRealloc(instruction);
+	case Opcode::ReallocImmediate: return executeReallocImmediate(instruction);
 	case Opcode::Free: return executeFree(instruction);
+	case Opcode::ArenaCreate: return executeArenaCreate(instruction);
+	case Opcode::ArenaAlloc: return executeArenaAlloc(instruction);
+	case Opcode::ArenaReset: return executeArenaReset(instruction);
+	case Opcode::ArenaDestroy: return executeArenaDestroy(instruction);
 
 	default: return resultError("Unrecognised opcode");
 	}
@@ -279,6 +686,40 @@ ResultInfo Processor<Settings>::assertDataStackSize(std::size_t amount)
 	return resultSuccess();
 }
 
+template< typename Settings >
+ResultInfo Processor<Settings>::assertMemoryQuota(std::size_t requested, std::size_t released)
+{
+	if (this->memoryQuota == 0)
+		return resultSuccess();
+
+	const std::size_t liveBytes = this->allocator.getStatistics().getLiveBytes();
+	const std::size_t remaining = (liveBytes > released) ? (liveBytes - released) : 0;
+
+	if ((remaining > this->memoryQuota) || (requested > (this->memoryQuota - remaining)))
+		return resultError("Memory quota exceeded");
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::assertMemoryQuota(void)
+{
+	if ((this->memoryQuota != 0) && (this->allocator.getStatistics().getLiveBytes() > this->memoryQuota))
+		return resultError("Memory quota exceeded");
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::assertMemoryQuota(Address allocation)
+{
+	const ResultInfo resultInfo = assertMemoryQuota();
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		this->allocator.deallocate(this->memory, allocation);
+
+	return resultInfo;
+}
+
 //
 // Category 0 - Basic control
 //
@@ -292,6 +733,11 @@ ResultInfo Processor<Settings>::executeNop(Instruction instruction)
 template< typename Settings >
 ResultInfo Processor<Settings>::executeEnd(Instruction instruction)
 {
+	if (SettingsType::ReportAllocations)
+		this->reportAllocations();
+
+	this->environment.getPrinter().flush();
+
 	this->complete();
 	return resultSuccess();
 }
@@ -299,6 +745,9 @@ ResultInfo Processor<Settings>::executeEnd(Instruction instruction)
 template< typename Settings >
 ResultInfo Processor<Settings>::executeBreak(Instruction instruction)
 {
+	// The break handler may show output of its own
+	this->environment.getPrinter().flush();
+
 	if (this->breakHandler != nullptr)
 		this->breakHandler(this->environment, this->state);
 
@@ -312,8 +761,19 @@ ResultInfo Processor<Settings>::executePrintInt(Instruction instruction)
 	if (resultInfo.getStatus() == ResultStatus::Error)
 		return resultInfo;
 
+	// The operand chooses the base, 0 meaning decimal
+	const Word base = instruction.getOperand();
+
+	if ((base != 0) && (base != 2) && (base != 10) && (base != 16))
+		return resultError("Invalid number base");
+
 	const Word word = this->state.getDataStack().peek();
-	this->environment.getPrinter().print(word);
+
+	if ((base == 0) || (base == 10))
+		this->environment.getPrinter().print(word);
+	else
+		this->environment.getPrinter().print(word, static_cast<NumberBase>(base));
+
 	return resultSuccess();
 }
 
@@ -348,7 +808,7 @@ ResultInfo Processor<Settings>::executePrintStack(Instruction instruction)
 	{
 		printer.print(stack[0]);
 
-		for (std::uint8_t i = 1; i < stack.getCount(); ++i)
+		for (std::size_t i = 1; i < stack.getCount(); ++i)
 			printer.printMany(", ", stack[i]);
 	}
 
@@ -357,6 +817,68 @@ ResultInfo Processor<Settings>::executePrintStack(Instruction instruction)
 	return resultSuccess();
 }
 
+template< typename Settings >
+ResultInfo Processor<Settings>::executeExtend(Instruction instruction)
+{
+	const Word extension = instruction.getOperand();
+
+	if (extension > 0xFF)
+		return resultError("Invalid extension");
+
+	Instruction extended;
+
+	if (!this->fetch(extended))
+		return resultError("Jumped to invalid address");
+
+	return this->executeExtended(extended.getOpcode(), (extension << 24) | extended.getOperand());
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::executeExtended(Opcode opcode, Word operand)
+{
+	switch (opcode)
+	{
+	case Opcode::Push:
+		if (this->state.getDataStack().getCount() >= this->state.getDataStack().getCapacity())
+			return resultError("Data stack overflow");
+
+		this->state.getDataStack().push(operand);
+		return resultSuccess();
+
+	case Opcode::Call:
+		return this->callFunction(operand);
+
+	case Opcode::JumpRelative:
+		this->state.jumpRelative(static_cast<SWord>(operand));
+		return resultSuccess();
+
+	case Opcode::JumpAbsolute:
+		this->state.jumpAbsolute(operand);
+		return resultSuccess();
+
+	case Opcode::AddImmediate: return executeExtendedImmediate([operand](Word & value) { value += operand; });
+	case Opcode::SubtractImmediate: return executeExtendedImmediate([operand](Word & value) { value -= operand; });
+	case Opcode::AndImmediate: return executeExtendedImmediate([operand](Word & value) { value &= operand; });
+	case Opcode::OrImmediate: return executeExtendedImmediate([operand](Word & value) { value |= operand; });
+	case Opcode::ExclusiveOrImmediate: return executeExtendedImmediate([operand](Word & value) { value ^= operand; });
+
+	default: return resultError("Instruction can't be extended");
+	}
+}
+
+template< typename Settings >
+template< typename Operation >
+ResultInfo Processor<Settings>::executeExtendedImmediate(Operation && operation)
+{
+	const ResultInfo resultInfo = assertDataStackSize(1);
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		return resultInfo;
+
+	operation(this->state.getDataStack().peek());
+
+	return resultSuccess();
+}
+
 
 
 //
@@ -382,8 +904,7 @@ ResultInfo Processor<Settings>::executeDrop(Instruction instruction)
 	if (resultInfo.getStatus() == ResultStatus::Error)
 		return resultInfo;
 
-	for (std::size_t i = 0; i < dropCount; ++i)
-		this->state.getDataStack().drop();
+	this->state.getDataStack().dropN(dropCount);
 
 	return resultSuccess();
 }
@@ -393,17 +914,12 @@ ResultInfo Processor<Settings>::executePick(Instruction instruction)
 {
 	const Word offset = instruction.getOperand() + 1;
 
-	const ResultInfo resultInfo = assertDataStackSize(offset);
+	const ResultInfo resultInfo = assertDataStackSize(offset + 1);
 	if (resultInfo.getStatus() == ResultStatus::Error)
 		return resultInfo;
 
-	auto & stack = this->state.getDataStack();
-
-	const auto end = stack.getCount() - 1;
-	const auto index = (end - offset);
-	const auto element = stack[index];
-
-	stack.push(element);
+	if (!this->state.getDataStack().pickN(offset))
+		return resultError("Data stack overflow");
 
 	return resultSuccess();
 }
@@ -413,18 +929,13 @@ ResultInfo Processor<Settings>::executeRoll(Instruction instruction)
 {
 	const auto offset = instruction.getOperand();
 
-	const ResultInfo resultInfo = assertDataStackSize(offset);
+	const ResultInfo resultInfo = assertDataStackSize(offset + 1);
 	if (resultInfo.getStatus() == ResultStatus::Error)
 		return resultInfo;
 
-	auto & stack = this->state.getDataStack();
-
-	const auto end = stack.getCount() - 1;
-	const auto index = (end - offset);
-	const auto element = stack[index];
-
-	stack.removeAt(index);
-	stack.push(element);
+	// Rolling never grows the stack, so it can only fail for want of items
+	if (!this->state.getDataStack().rollN(offset))
+		return resultError("Data stack underflow");
 
 	return resultSuccess();
 }
@@ -516,6 +1027,23 @@ ResultInfo Processor<Settings>::executeOver(Instruction instruction)
 	return resultSuccess();
 }
 
+template< typename Settings >
+ResultInfo Processor<Settings>::executePushConstant(Instruction instruction)
+{
+	const auto & constants = this->environment.getConstants();
+	const Word index = instruction.getOperand();
+
+	if (index >= constants.getCount())
+		return resultError("Invalid constant");
+
+	if (this->state.getDataStack().getCount() >= this->state.getDataStack().getCapacity())
+		return resultError("Data stack overflow");
+
+	this->state.getDataStack().push(constants[index]);
+
+	return resultSuccess();
+}
+
 
 
 //
@@ -527,9 +1055,7 @@ ResultInfo Processor<Settings>::executeCall(Instruction instruction)
 {
 	const Word address = instruction.getOperand();
 
-	this->state.functionCall(address);
-
-	return resultSuccess();
+	return this->callFunction(address);
 }
 
 template< typename Settings >
@@ -544,9 +1070,7 @@ ResultInfo Processor<Settings>::executeCallIndirect(Instruction instruction)
 	const Word address = stack.peek();
 	stack.drop();
 
-	this->state.functionCall(address);
-
-	return resultSuccess();
+	return this->callFunction(address);
 }
 
 template< typename Settings >
@@ -580,6 +1104,28 @@ ResultInfo Processor<Settings>::executeJumpAbsolute(Instruction instruction)
 	return resultSuccess();
 }
 
+template< typename Settings >
+ResultInfo Processor<Settings>::executeCallNative(Instruction instruction)
+{
+	const Word index = instruction.getOperand();
+
+	if (index >= this->nativeFunctions.getCount())
+		return resultError("Invalid native function index");
+
+	const auto & function = this->nativeFunctions[index];
+
+	const ResultInfo resultInfo = assertDataStackSize(function.getInputCount());
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		return resultInfo;
+
+	const auto & stack = this->state.getDataStack();
+
+	if ((stack.getCount() - function.getInputCount() + function.getOutputCount()) > stack.getCapacity())
+		return resultError("Data stack overflow");
+
+	return function.invoke(this->environment, this->state);
+}
+
 
 
 //
@@ -1052,16 +1598,12 @@ ResultInfo Processor<Settings>::executeLoadByte(Instruction instruction)
 	auto & stack = this->state.getDataStack();
 
 	const Word address = stack.peek();
-	const Byte * pointer = reinterpret_cast<const Byte *>(address);
-	stack.peek() = *pointer;
 
-	/*const Word address = stack.peek();
-	stack.drop();
-
-	const Byte * pointer = reinterpret_cast<const Byte *>(address);
+	Word value;
+	if (!this->memory.loadByte(address, value))
+		return resultError("Memory access out of bounds");
 
-	const Word result = *pointer;
-	stack.push(result);*/
+	stack.peek() = value;
 
 	return resultSuccess();
 }
@@ -1081,9 +1623,8 @@ ResultInfo Processor<Settings>::executeStoreByte(Instruction instruction)
 	const Word address = stack.peek();
 	stack.drop();
 
-	Byte * pointer = reinterpret_cast<Byte *>(address);
-
-	*pointer = value;
+	if (!this->memory.storeByte(address, value))
+		return resultError("Memory access out of bounds");
 
 	return resultSuccess();
 }
@@ -1098,16 +1639,12 @@ ResultInfo Processor<Settings>::executeLoadWord(Instruction instruction)
 	auto & stack = this->state.getDataStack();
 
 	const Word address = stack.peek();
-	const Word * pointer = reinterpret_cast<const Word *>(address);
-	stack.peek() = *pointer;
-
-	/*const Word address = stack.peek();
-	stack.drop();
 
-	const Word * pointer = reinterpret_cast<const Word *>(address);
+	Word value;
+	if (!this->memory.loadWord(address, value))
+		return resultError("Memory access out of bounds");
 
-	const Word result = *pointer;
-	stack.push(result);*/
+	stack.peek() = value;
 
 	return resultSuccess();
 }
@@ -1127,9 +1664,8 @@ ResultInfo Processor<Settings>::executeStoreWord(Instruction instruction)
 	const Word address = stack.peek();
 	stack.drop();
 
-	Word * pointer = reinterpret_cast<Word *>(address);
-
-	*pointer = value;
+	if (!this->memory.storeWord(address, value))
+		return resultError("Memory access out of bounds");
 
 	return resultSuccess();
 }
@@ -1150,18 +1686,17 @@ ResultInfo Processor<Settings>::executeMalloc(Instruction instruction)
 
 	const Word size = stack.peek();
 
-	const void * data = std::malloc(size);
+	const ResultInfo requestResultInfo = assertMemoryQuota(size, 0);
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
 
-	stack.peek() = reinterpret_cast<Word>(data);
+	const Address result = this->allocateCollecting(0, [this, size]() { return this->allocator.allocate(this->memory, size); });
 
-	/*const Word size = stack.peek();
-	stack.drop();
+	const ResultInfo quotaResultInfo = assertMemoryQuota(result);
+	if (quotaResultInfo.getStatus() == ResultStatus::Error)
+		return quotaResultInfo;
 
-	void * raw = std::malloc(size);
-	const char * data = reinterpret_cast<const char*>(raw);
-
-	const Word result = reinterpret_cast<Word>(data);
-	stack.push(result);*/
+	stack.peek() = result;
 
 	return resultSuccess();
 }
@@ -1169,16 +1704,24 @@ ResultInfo Processor<Settings>::executeMalloc(Instruction instruction)
 template< typename Settings >
 ResultInfo Processor<Settings>::executeMallocImmediate(Instruction instruction)
 {
-	// Todo: assert stack overflow
-
 	auto & stack = this->state.getDataStack();
 
+	// Checked first, as there would be nowhere to put the block
+	if (stack.isFull())
+		return resultError("Data stack overflow");
+
 	const Word size = instruction.getOperand();
 
-	void * raw = std::malloc(size);
-	const char * data = reinterpret_cast<const char*>(raw);
+	const ResultInfo requestResultInfo = assertMemoryQuota(size, 0);
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
+
+	const Address result = this->allocateCollecting(0, [this, size]() { return this->allocator.allocate(this->memory, size); });
+
+	const ResultInfo quotaResultInfo = assertMemoryQuota(result);
+	if (quotaResultInfo.getStatus() == ResultStatus::Error)
+		return quotaResultInfo;
 
-	const Word result = reinterpret_cast<Word>(data);
 	stack.push(result);
 
 	return resultSuccess();
@@ -1199,10 +1742,16 @@ ResultInfo Processor<Settings>::executeCalloc(Instruction instruction)
 	const Word size = stack.peek();
 	stack.drop();
 
-	void * raw = std::calloc(count, size);
-	const char * data = reinterpret_cast<const char*>(raw);
+	const ResultInfo requestResultInfo = assertMemoryQuota(getZeroedSize(count, size), 0);
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
+
+	const Address result = this->allocateCollecting(0, [this, count, size]() { return this->allocator.allocateZeroed(this->memory, count, size); });
+
+	const ResultInfo quotaResultInfo = assertMemoryQuota(result);
+	if (quotaResultInfo.getStatus() == ResultStatus::Error)
+		return quotaResultInfo;
 
-	const Word result = reinterpret_cast<Word>(data);
 	stack.push(result);
 
 	return resultSuccess();
@@ -1222,10 +1771,16 @@ ResultInfo Processor<Settings>::executeCallocImmediate(Instruction instruction)
 
 	const Word size = instruction.getOperand();
 
-	void * raw = std::calloc(count, size);
-	const char * data = reinterpret_cast<const char*>(raw);
+	const ResultInfo requestResultInfo = assertMemoryQuota(getZeroedSize(count, size), 0);
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
+
+	const Address result = this->allocateCollecting(0, [this, count, size]() { return this->allocator.allocateZeroed(this->memory, count, size); });
+
+	const ResultInfo quotaResultInfo = assertMemoryQuota(result);
+	if (quotaResultInfo.getStatus() == ResultStatus::Error)
+		return quotaResultInfo;
 
-	const Word result = reinterpret_cast<Word>(data);
 	stack.push(result);
 
 	return resultSuccess();
@@ -1244,15 +1799,20 @@ ResultInfo Processor<Settings>::executeRealloc(Instruction instruction)
 	stack.drop();
 
 	const Word address = stack.peek();
+
+	// The block stays on the stack if it can't grow
+	const ResultInfo requestResultInfo = assertMemoryQuota(size, this->memory.getAllocationSize(address));
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
+
 	stack.drop();
 
-	void * pointer = reinterpret_cast<void *>(address);
-	const char * data = reinterpret_cast<const char *>(std::realloc(pointer, size));
+	const Address result = this->allocateCollecting(address, [this, address, size]() { return this->allocator.reallocate(this->memory, address, size); });
 
-	const Word result = reinterpret_cast<Word>(data);
+	// The old block may already be gone, so the result is kept even if rounding broke the quota
 	stack.push(result);
 
-	return resultSuccess();
+	return assertMemoryQuota();
 }
 
 template< typename Settings >
@@ -1267,15 +1827,20 @@ ResultInfo Processor<Settings>::executeReallocImmediate(Instruction instruction)
 	const Word size = instruction.getOperand();
 
 	const Word address = stack.peek();
+
+	// The block stays on the stack if it can't grow
+	const ResultInfo requestResultInfo = assertMemoryQuota(size, this->memory.getAllocationSize(address));
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
+
 	stack.drop();
 
-	void * pointer = reinterpret_cast<void *>(address);
-	const char * data = reinterpret_cast<const char *>(std::realloc(pointer, size));
+	const Address result = this->allocateCollecting(address, [this, address, size]() { return this->allocator.reallocate(this->memory, address, size); });
 
-	const Word result = reinterpret_cast<Word>(data);
+	// The old block may already be gone, so the result is kept even if rounding broke the quota
 	stack.push(result);
 
-	return resultSuccess();
+	return assertMemoryQuota();
 }
 
 template< typename Settings >
@@ -1287,12 +1852,115 @@ ResultInfo Processor<Settings>::executeFree(Instruction instruction)
 
 	auto & stack = this->state.getDataStack();
 
-	const Word value = stack.peek();
+	const Word address = stack.peek();
+	stack.drop();
+
+	if (!this->allocator.deallocate(this->memory, address))
+		return resultError("Invalid free");
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::executeArenaCreate(Instruction instruction)
+{
+	auto & stack = this->state.getDataStack();
+
+	if (stack.isFull())
+		return resultError("Data stack overflow");
+
+	for (std::size_t index = 0; index < ArenaCount; ++index)
+		if (!this->arenas[index].isActive())
+		{
+			this->arenas[index].activate();
+			stack.push(static_cast<Word>(index + 1));
+			return resultSuccess();
+		}
+
+	stack.push(0);
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::executeArenaAlloc(Instruction instruction)
+{
+	const ResultInfo resultInfo = assertDataStackSize(2);
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		return resultInfo;
+
+	auto & stack = this->state.getDataStack();
+
+	const Word size = stack.peek();
 	stack.drop();
 
-	char * data = reinterpret_cast<char *>(value);
+	Arena * arena = this->getArena(stack.peek());
+
+	if (arena == nullptr)
+		return resultError("Invalid arena");
+
+	const ResultInfo requestResultInfo = assertMemoryQuota(size, 0);
+	if (requestResultInfo.getStatus() == ResultStatus::Error)
+		return requestResultInfo;
 
-	std::free(data);
+	const Address result = this->allocateCollecting(0, [this, arena, size]() { return arena->allocate(this->allocator, this->memory, size); });
+
+	// A new chunk can take more than size, it stays with the arena and is released along with it
+	const ResultInfo quotaResultInfo = assertMemoryQuota();
+	if (quotaResultInfo.getStatus() == ResultStatus::Error)
+		return quotaResultInfo;
+
+	stack.peek() = result;
 
 	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::executeArenaReset(Instruction instruction)
+{
+	const ResultInfo resultInfo = assertDataStackSize(1);
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		return resultInfo;
+
+	auto & stack = this->state.getDataStack();
+
+	Arena * arena = this->getArena(stack.peek());
+	stack.drop();
+
+	if (arena == nullptr)
+		return resultError("Invalid arena");
+
+	arena->reset(this->allocator, this->memory);
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+ResultInfo Processor<Settings>::executeArenaDestroy(Instruction instruction)
+{
+	const ResultInfo resultInfo = assertDataStackSize(1);
+	if (resultInfo.getStatus() == ResultStatus::Error)
+		return resultInfo;
+
+	auto & stack = this->state.getDataStack();
+
+	Arena * arena = this->getArena(stack.peek());
+	stack.drop();
+
+	if (arena == nullptr)
+		return resultError("Invalid arena");
+
+	arena->release(this->allocator, this->memory);
+
+	return resultSuccess();
+}
+
+template< typename Settings >
+Arena * Processor<Settings>::getArena(Word handle)
+{
+	if ((handle == 0) || (handle > ArenaCount))
+		return nullptr;
+
+	Arena & arena = this->arenas[handle - 1];
+	return arena.isActive() ? &arena : nullptr;
 }
\ No newline at end of file
@@ -30,8 +30,8 @@ public:
 	static constexpr std::size_t ReturnStackSize = SettingsType::ReturnStackSize;
 
 public:
-	using DataStack = Stack<Word, DataStackSize>;
-	using ReturnStack = Stack<Address, ReturnStackSize>;
+	using DataStack = Stack<Word, DataStackSize, typename SettingsType::template StackContainerType<Word, DataStackSize>>;
+	using ReturnStack = Stack<Address, ReturnStackSize, typename SettingsType::template StackContainerType<Address, ReturnStackSize>>;
 
 private:
 	DataStack dataStack = DataStack();
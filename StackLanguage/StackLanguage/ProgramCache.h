@@ -0,0 +1,204 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Hash.h"
+#include "Module.h"
+#include "Verifier.h"
+#include "MappedFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+//
+// A directory of programs that have already been built and verified.
+//
+// Entries are keyed by a hash of the program's original content, e.g. assembly source,
+// combined with the module format version, the verifier version
+// and a hash of the settings the program was verified for.
+// A change to any of them means a different key, so stale entries are never found.
+//
+// Each entry is a ProgramCacheHeader followed by the finished module,
+// so a warm start is a single mapping with nothing left to assemble or verify.
+// Only programs that passed verification are stored.
+//
+
+struct ProgramCacheHeader
+{
+	// "SLPC" when read as bytes on a little-endian machine
+	static constexpr std::uint32_t Magic = 0x43504C53u;
+	static constexpr std::uint32_t CurrentVersion = 2;
+
+	static constexpr std::uint32_t VerifiedFlag = 0x1;
+
+	std::uint32_t magic;
+	std::uint32_t version;
+	std::uint64_t key;
+	std::uint64_t contentHash;
+	std::uint64_t contentSize;
+	std::uint64_t settingsHash;
+	std::uint32_t moduleVersion;
+	std::uint32_t verifierVersion;
+	std::uint32_t flags;
+
+	// Reserved, must be 0
+	std::uint32_t reserved;
+};
+
+static_assert((sizeof(ProgramCacheHeader) % sizeof(Word)) == 0, "Cached modules must stay aligned");
+
+// Hashes the settings that verification depends on
+template< typename Settings >
+std::uint64_t hashSettings(void)
+{
+	std::uint64_t hash = HashSeed;
+
+	hash = hashValue(static_cast<std::uint64_t>(Settings::DataStackSize), hash);
+	hash = hashValue(static_cast<std::uint64_t>(Settings::ReturnStackSize), hash);
+	hash = hashValue(static_cast<std::uint64_t>(Settings::NativeFunctionListSize), hash);
+	hash = hashValue(static_cast<std::uint64_t>(Settings::MemorySize), hash);
+	hash = hashValue(static_cast<std::uint64_t>(Settings::MemoryBounds), hash);
+	hash = hashValue(static_cast<std::uint64_t>(Settings::ArenaCount), hash);
+	hash = hashValue(static_cast<std::uint64_t>(sizeof(Word)), hash);
+
+	return hash;
+}
+
+class ProgramCache
+{
+public:
+	struct Key
+	{
+		std::uint64_t value;
+		std::uint64_t contentHash;
+		std::uint64_t contentSize;
+	};
+
+private:
+	std::string directory;
+	std::uint64_t settingsHash;
+
+public:
+	ProgramCache(std::string directory, std::uint64_t settingsHash)
+		: directory(std::move(directory)), settingsHash(settingsHash)
+	{
+	}
+
+	// O(N)
+	Key getKey(const Byte * content, std::size_t size) const
+	{
+		Key key;
+		key.contentHash = hashBytes(content, size);
+		key.contentSize = size;
+		key.value = hashValue(this->settingsHash, key.contentHash);
+		key.value = hashValue(static_cast<std::uint32_t>(ModuleHeader::CurrentVersion), key.value);
+		key.value = hashValue(static_cast<std::uint32_t>(VerifierVersion), key.value);
+		key.value = hashValue(static_cast<std::uint32_t>(ProgramCacheHeader::CurrentVersion), key.value);
+		return key;
+	}
+
+	// Returns false if there is no usable entry for key
+	bool find(const Key & key, Module & module) const
+	{
+		MappedFile file;
+
+		if (!file.open(this->getPath(key).c_str()) || (file.getSize() < sizeof(ProgramCacheHeader)))
+			return false;
+
+		ProgramCacheHeader header;
+		std::memcpy(&header, file.getData(), sizeof(header));
+
+		if (!this->isMatch(header, key))
+			return false;
+
+		return module.load(std::move(file), sizeof(ProgramCacheHeader)).isSuccess();
+	}
+
+	// Stores a verified module.
+	// Returns false if the entry couldn't be written, which leaves the cache as it was.
+	bool store(const Key & key, const Byte * module, std::size_t size) const;
+
+private:
+	std::string getPath(const Key & key) const
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.slc", static_cast<unsigned long long>(key.value));
+		return this->directory + '/' + name;
+	}
+
+	bool isMatch(const ProgramCacheHeader & header, const Key & key) const
+	{
+		return (header.magic == ProgramCacheHeader::Magic) &&
+			(header.version == ProgramCacheHeader::CurrentVersion) &&
+			(header.key == key.value) &&
+			(header.contentHash == key.contentHash) &&
+			(header.contentSize == key.contentSize) &&
+			(header.settingsHash == this->settingsHash) &&
+			(header.moduleVersion == ModuleHeader::CurrentVersion) &&
+			(header.verifierVersion == VerifierVersion) &&
+			((header.flags & ProgramCacheHeader::VerifiedFlag) != 0);
+	}
+};
+
+//
+// Definition
+//
+
+inline bool ProgramCache::store(const Key & key, const Byte * module, std::size_t size) const
+{
+	ProgramCacheHeader header;
+	header.magic = ProgramCacheHeader::Magic;
+	header.version = ProgramCacheHeader::CurrentVersion;
+	header.key = key.value;
+	header.contentHash = key.contentHash;
+	header.contentSize = key.contentSize;
+	header.settingsHash = this->settingsHash;
+	header.moduleVersion = ModuleHeader::CurrentVersion;
+	header.verifierVersion = VerifierVersion;
+	header.flags = ProgramCacheHeader::VerifiedFlag;
+	header.reserved = 0;
+
+	const std::string path = this->getPath(key);
+
+	// Written under another name first so that a reader never maps half an entry
+	const std::string temporaryPath = (path + ".tmp");
+
+	std::FILE * file = std::fopen(temporaryPath.c_str(), "wb");
+
+	if (file == nullptr)
+		return false;
+
+	bool written = (std::fwrite(&header, sizeof(header), 1, file) == 1);
+	written = written && (std::fwrite(module, 1, size, file) == size);
+	written = (std::fclose(file) == 0) && written;
+
+	if (written)
+	{
+		std::remove(path.c_str());
+		written = (std::rename(temporaryPath.c_str(), path.c_str()) == 0);
+	}
+
+	if (!written)
+		std::remove(temporaryPath.c_str());
+
+	return written;
+}
@@ -18,15 +18,60 @@
 
 #include "StdInt.h"
 #include "PrinterDecorator.h"
+#include "Instruction.h"
+#include "InstructionStore.h"
+#include "CompactCode.h"
+#include "List.h"
+#include "Deque.h"
+#include "ProcessorState.h"
+#include "LinearMemory.h"
+#include "HeapAllocator.h"
 
 template< typename Printer >
 struct DefaultSettings
 {
 	using PrinterType = PrinterDecorator<Printer>;
 
+	// Deque rounds each of these sizes up to a power of two for its storage
 	static constexpr std::size_t InstructionListSize = 255;
 	static constexpr std::size_t DataStackSize = 64;
 	static constexpr std::size_t ReturnStackSize = 64;
+	static constexpr std::size_t NativeFunctionListSize = 32;
+
+	// InstructionStore grows as needed and is shared between copies.
+	// List keeps up to InstructionListSize instructions inline,
+	// InstructionView runs code owned elsewhere, e.g. by a Module.
+	// CompactCode is a denser variable-length encoding, see its description.
+	// It takes under half the space but is slower to run, so it suits programs that are large rather than hot.
+	using InstructionListType = InstructionStore;
+
+	// Deque keeps each stack inline at its full size.
+	// GrowableArray starts small and grows up to the stack size,
+	// which can then be changed per processor with setDataStackCapacity and setReturnStackCapacity.
+	template< typename Type, std::size_t Capacity >
+	using StackContainerType = Deque<Type, Capacity>;
+
+	// UnifiedProcessorState keeps both stacks in a single buffer, see its description
+	template< typename StateSettings >
+	using ProcessorStateTemplate = ProcessorState<StateSettings>;
+
+	static constexpr std::size_t MemorySize = (1u << 20);
+	static constexpr MemoryBoundsMode MemoryBounds = MemoryBoundsMode::Mask;
+
+	using MemoryType = LinearMemory<MemorySize, MemoryBounds>;
+
+	// PoolAllocator is faster for programs that allocate many small blocks,
+	// CollectingAllocator reclaims blocks that programs forget to free
+	using AllocatorType = HeapAllocator;
+
+	// Prints allocation statistics and leaks when End is executed
+	static constexpr bool ReportAllocations = false;
+
+	// The most bytes a program may have allocated at once, 0 for no limit.
+	// Can be changed per processor with setMemoryQuota.
+	static constexpr std::size_t MemoryQuota = 0;
+
+	static constexpr std::size_t ArenaCount = 16;
 
 	using EnvironmentSettingsType = DefaultSettings;
 	using ProcessorStateSettingsType = DefaultSettings;
@@ -145,13 +145,13 @@ public:
 	// O(N)
 	IndexOfType indexOfFirst(const ValueType & item) const
 	{
-		return this->container.indexOfLast(item);
+		return this->container.indexOfFirst(item);
 	}
 	
 	// O(N)
 	IndexOfType indexOfLast(const ValueType & item) const
 	{
-		return this->container.indexOfFirst(item);
+		return this->container.indexOfLast(item);
 	}
 	
 public:
@@ -160,6 +160,18 @@ public:
 	// Specific Member Functions
 	//
 
+	// O(1)
+	ContainerType & getContainer(void) noexcept
+	{
+		return this->container;
+	}
+
+	// O(1)
+	const ContainerType & getContainer(void) const noexcept
+	{
+		return this->container;
+	}
+
 	// O(1)
 	ValueType & peek(void)
 	{
@@ -183,6 +195,34 @@ public:
 	{
 		this->container.unappend();
 	}
+
+	// O(1) for trivially destructible types
+	// Returns false if there are fewer than amount items
+	bool dropN(SizeType amount)
+	{
+		return this->container.unappendN(amount);
+	}
+
+	// O(1)
+	// Pushes a copy of the item depth places below the top, pickN(0) duplicates the top
+	bool pickN(SizeType depth)
+	{
+		if (depth >= this->getCount())
+			return false;
+
+		const ValueType item = this->container[this->container.getLastIndex() - depth];
+		return this->container.append(item);
+	}
+
+	// O(N)
+	// Moves the item depth places below the top to the top, rollN(1) swaps the top two items
+	bool rollN(SizeType depth)
+	{
+		if (depth >= this->getCount())
+			return false;
+
+		return this->container.moveToLast(this->container.getLastIndex() - depth);
+	}
 	
 	// O(N)
 	bool removeFirst(const ValueType & item)
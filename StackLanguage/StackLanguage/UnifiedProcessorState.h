@@ -0,0 +1,419 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+#include "Utility.h"
+#include "LanguageTypes.h"
+#include "VectorSearch.h"
+
+//
+// A ProcessorState that keeps both stacks in one buffer.
+//
+// The data stack grows up from the start of the buffer and the return stack
+// grows down from the end, so either stack is full exactly when the two meet.
+// That makes every overflow check a single comparison, and lets a deeply
+// recursive program borrow room from the data stack and vice versa.
+// The buffer holds DataStackSize + ReturnStackSize words in total.
+//
+// The stacks offer the parts of the Stack interface that the processor uses.
+//
+
+template< typename Settings >
+class UnifiedProcessorState
+{
+public:
+	using SettingsType = Settings;
+
+public:
+	static constexpr std::size_t DataStackSize = SettingsType::DataStackSize;
+	static constexpr std::size_t ReturnStackSize = SettingsType::ReturnStackSize;
+	static constexpr std::size_t StorageSize = (DataStackSize + ReturnStackSize);
+
+	static_assert(sizeof(Address) == sizeof(Word), "Both stacks must share a buffer of words");
+
+private:
+	template< bool GrowsUp >
+	class Region;
+
+public:
+	using DataStack = Region<true>;
+	using ReturnStack = Region<false>;
+
+private:
+	alignas(64) Word storage[StorageSize] = {};
+
+	// Index one past the top of the data stack
+	std::size_t dataNext = 0;
+
+	// Index of the top of the return stack
+	std::size_t returnNext = StorageSize;
+
+	Address instructionPointer = 0;
+
+	DataStack dataStack { this };
+	ReturnStack returnStack { this };
+
+public:
+	UnifiedProcessorState(void) = default;
+
+	UnifiedProcessorState(const UnifiedProcessorState & other)
+	{
+		*this = other;
+	}
+
+	// The stacks keep pointing at their own state
+	UnifiedProcessorState & operator =(const UnifiedProcessorState & other)
+	{
+		for (std::size_t index = 0; index < StorageSize; ++index)
+			this->storage[index] = other.storage[index];
+
+		this->dataNext = other.dataNext;
+		this->returnNext = other.returnNext;
+		this->instructionPointer = other.instructionPointer;
+		return *this;
+	}
+
+	DataStack & getDataStack(void)
+	{
+		return this->dataStack;
+	}
+
+	const DataStack & getDataStack(void) const
+	{
+		return this->dataStack;
+	}
+
+	ReturnStack & getReturnStack(void)
+	{
+		return this->returnStack;
+	}
+
+	const ReturnStack & getReturnStack(void) const
+	{
+		return this->returnStack;
+	}
+
+	const Address & getInstructionPointer(void) const
+	{
+		return this->instructionPointer;
+	}
+
+	void incrementInstructionPointer(void)
+	{
+		++this->instructionPointer;
+	}
+
+	void functionCall(Address address)
+	{
+		this->returnStack.push(this->instructionPointer);
+		this->instructionPointer = address;
+	}
+
+	void functionReturn(void)
+	{
+		this->instructionPointer = this->returnStack.peek();
+		this->returnStack.drop();
+	}
+
+	void jumpAbsolute(Address address)
+	{
+		this->instructionPointer = address;
+	}
+
+	void jumpRelative(AddressOffset addressOffset)
+	{
+		this->instructionPointer += addressOffset;
+	}
+};
+
+//
+// Region
+//
+
+template< typename Settings >
+template< bool GrowsUp >
+class UnifiedProcessorState<Settings>::Region
+{
+public:
+	using ValueType = Word;
+	using SizeType = std::size_t;
+	using IndexType = std::size_t;
+	using IndexOfType = std::size_t;
+
+	static constexpr IndexOfType InvalidIndex = static_cast<IndexOfType>(~0);
+
+private:
+	UnifiedProcessorState * owner;
+
+public:
+	explicit Region(UnifiedProcessorState * owner)
+		: owner(owner)
+	{
+	}
+
+	Region(const Region &) = delete;
+	Region & operator =(const Region &) = delete;
+
+	// O(1)
+	bool isEmpty(void) const noexcept
+	{
+		return (this->getCount() == 0);
+	}
+
+	// O(1)
+	bool isFull(void) const noexcept
+	{
+		return (this->owner->dataNext == this->owner->returnNext);
+	}
+
+	// O(1)
+	SizeType getCount(void) const noexcept
+	{
+		return GrowsUp ? this->owner->dataNext : (StorageSize - this->owner->returnNext);
+	}
+
+	// O(1)
+	// Shrinks as the other stack grows
+	SizeType getCapacity(void) const noexcept
+	{
+		return GrowsUp ? this->owner->returnNext : (StorageSize - this->owner->dataNext);
+	}
+
+	// O(1)
+	// Index 0 is the bottom of the stack
+	ValueType & operator [](IndexType index)
+	{
+		return this->owner->storage[this->getStorageIndex(index)];
+	}
+
+	// O(1)
+	const ValueType & operator [](IndexType index) const
+	{
+		return this->owner->storage[this->getStorageIndex(index)];
+	}
+
+	// O(N)
+	bool contains(const ValueType & item) const
+	{
+		return (this->indexOfFirst(item) != InvalidIndex);
+	}
+
+	// O(N)
+	IndexOfType indexOfFirst(const ValueType & item) const;
+
+	// O(N)
+	IndexOfType indexOfLast(const ValueType & item) const;
+
+	// O(1)
+	ValueType & peek(void)
+	{
+		return this->owner->storage[this->getTopIndex()];
+	}
+
+	// O(1)
+	const ValueType & peek(void) const
+	{
+		return this->owner->storage[this->getTopIndex()];
+	}
+
+	// O(1)
+	bool push(const ValueType & item)
+	{
+		if (this->isFull())
+			return false;
+
+		if (GrowsUp)
+			this->owner->storage[this->owner->dataNext++] = item;
+		else
+			this->owner->storage[--this->owner->returnNext] = item;
+
+		return true;
+	}
+
+	// O(1)
+	void drop(void)
+	{
+		if (this->isEmpty())
+			return;
+
+		if (GrowsUp)
+			--this->owner->dataNext;
+		else
+			++this->owner->returnNext;
+	}
+
+	// O(1)
+	// Returns false if there are fewer than amount items
+	bool dropN(SizeType amount)
+	{
+		if (amount > this->getCount())
+			return false;
+
+		if (GrowsUp)
+			this->owner->dataNext -= amount;
+		else
+			this->owner->returnNext += amount;
+
+		return true;
+	}
+
+	// O(1)
+	// Pushes a copy of the item depth places below the top, pickN(0) duplicates the top
+	bool pickN(SizeType depth)
+	{
+		if (depth >= this->getCount())
+			return false;
+
+		const ValueType item = (*this)[this->getCount() - 1 - depth];
+		return this->push(item);
+	}
+
+	// O(N)
+	// Moves the item depth places below the top to the top, rollN(1) swaps the top two items
+	bool rollN(SizeType depth)
+	{
+		if (depth >= this->getCount())
+			return false;
+
+		const ValueType item = (*this)[this->getCount() - 1 - depth];
+
+		this->removeAt(this->getCount() - 1 - depth);
+		this->push(item);
+
+		return true;
+	}
+
+	// O(N)
+	bool removeAt(IndexType index);
+
+	// O(N)
+	bool insert(IndexType index, const ValueType & item);
+
+private:
+	// O(1)
+	IndexType getStorageIndex(IndexType index) const noexcept
+	{
+		return GrowsUp ? index : (StorageSize - 1 - index);
+	}
+
+	// O(1)
+	IndexType getTopIndex(void) const noexcept
+	{
+		return GrowsUp ? (this->owner->dataNext - 1) : this->owner->returnNext;
+	}
+
+	// O(1)
+	// The lowest storage index in use
+	IndexType getLowestIndex(void) const noexcept
+	{
+		return GrowsUp ? 0 : this->owner->returnNext;
+	}
+};
+
+// O(N)
+template< typename Settings >
+template< bool GrowsUp >
+auto UnifiedProcessorState<Settings>::Region<GrowsUp>::indexOfFirst(const ValueType & item) const -> IndexOfType
+{
+	const SizeType count = this->getCount();
+	const ValueType * data = &this->owner->storage[this->getLowestIndex()];
+
+	// The return stack is stored upside down
+	const SizeType index = GrowsUp ? VectorSearchFor<ValueType>::findFirst(data, count, item) : VectorSearchFor<ValueType>::findLast(data, count, item);
+
+	if (index == count)
+		return InvalidIndex;
+
+	return GrowsUp ? index : (count - 1 - index);
+}
+
+// O(N)
+template< typename Settings >
+template< bool GrowsUp >
+auto UnifiedProcessorState<Settings>::Region<GrowsUp>::indexOfLast(const ValueType & item) const -> IndexOfType
+{
+	const SizeType count = this->getCount();
+	const ValueType * data = &this->owner->storage[this->getLowestIndex()];
+
+	const SizeType index = GrowsUp ? VectorSearchFor<ValueType>::findLast(data, count, item) : VectorSearchFor<ValueType>::findFirst(data, count, item);
+
+	if (index == count)
+		return InvalidIndex;
+
+	return GrowsUp ? index : (count - 1 - index);
+}
+
+// O(N)
+template< typename Settings >
+template< bool GrowsUp >
+bool UnifiedProcessorState<Settings>::Region<GrowsUp>::removeAt(IndexType index)
+{
+	if (index >= this->getCount())
+		return false;
+
+	// Everything above index moves one place towards the bottom
+	Word * storage = this->owner->storage;
+
+	if (GrowsUp)
+	{
+		const IndexType next = this->owner->dataNext;
+		std::memmove(&storage[index], &storage[index + 1], (next - index - 1) * sizeof(Word));
+		--this->owner->dataNext;
+	}
+	else
+	{
+		const IndexType top = this->owner->returnNext;
+		const IndexType position = this->getStorageIndex(index);
+		std::memmove(&storage[top + 1], &storage[top], (position - top) * sizeof(Word));
+		++this->owner->returnNext;
+	}
+
+	return true;
+}
+
+// O(N)
+template< typename Settings >
+template< bool GrowsUp >
+bool UnifiedProcessorState<Settings>::Region<GrowsUp>::insert(IndexType index, const ValueType & item)
+{
+	if ((index >= this->getCount()) || this->isFull())
+		return false;
+
+	const ValueType copy = item;
+
+	// Everything from index up moves one place towards the top
+	Word * storage = this->owner->storage;
+
+	if (GrowsUp)
+	{
+		const IndexType next = this->owner->dataNext;
+		std::memmove(&storage[index + 1], &storage[index], (next - index) * sizeof(Word));
+		++this->owner->dataNext;
+	}
+	else
+	{
+		const IndexType top = this->owner->returnNext;
+		const IndexType position = this->getStorageIndex(index);
+		std::memmove(&storage[top - 1], &storage[top], (position - top + 1) * sizeof(Word));
+		--this->owner->returnNext;
+	}
+
+	(*this)[index] = copy;
+
+	return true;
+}
@@ -17,8 +17,13 @@
 //
 
 #if defined(ARDUINO)
+#include <string.h>
 namespace std
 {
+	using ::memmove;
+	using ::memcpy;
+	using ::memset;
+
 	template< typename T, T v > struct integral_constant
 	{
 		using value_type = T;
@@ -46,6 +51,9 @@ namespace std
 	template< typename T > struct is_lvalue_reference : false_type {};
 	template< typename T > struct is_lvalue_reference<T&> : true_type {};
 
+	template< typename T > struct is_trivially_copyable : bool_constant<__is_trivially_copyable(T)> {};
+	template< typename T > struct is_trivially_destructible : bool_constant<__has_trivial_destructor(T)> {};
+
 	template< typename T > /*constexpr*/ remove_reference_t<T> && move(T && t) noexcept
 	{
 		return static_cast<remove_reference_t<T> &&>(t);
@@ -63,5 +71,7 @@ namespace std
 	}
 }
 #else
+#include <cstring>
+#include <type_traits>
 #include <utility>
 #endif
\ No newline at end of file
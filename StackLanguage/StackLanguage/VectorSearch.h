@@ -0,0 +1,233 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "Utility.h"
+
+#if defined(__AVX2__)
+#define VECTOR_SEARCH_AVX2
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VECTOR_SEARCH_SSE2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//
+// Linear searches over arrays.
+//
+// Integral types of up to four bytes are compared a whole vector at a time,
+// 16 bytes with SSE2 and 32 bytes with AVX2, depending on what the compiler targets.
+// Anything else, or any other target, uses a plain loop.
+//
+// Each function returns count if the value isn't found.
+//
+
+template< typename Type, bool IsVectorised = false >
+struct VectorSearch
+{
+	// O(N)
+	static std::size_t findFirst(const Type * data, std::size_t count, const Type & value)
+	{
+		for (std::size_t index = 0; index < count; ++index)
+			if (data[index] == value)
+				return index;
+
+		return count;
+	}
+
+	// O(N)
+	static std::size_t findLast(const Type * data, std::size_t count, const Type & value)
+	{
+		for (std::size_t index = count; index > 0; --index)
+			if (data[index - 1] == value)
+				return (index - 1);
+
+		return count;
+	}
+};
+
+#if defined(VECTOR_SEARCH_SSE2)
+namespace VectorSearchDetail
+{
+	// Index of the lowest set bit, mask must not be 0
+	inline unsigned getLowestBit(std::uint32_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+	}
+
+	// Index of the highest set bit, mask must not be 0
+	inline unsigned getHighestBit(std::uint32_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanReverse(&index, mask);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(31 - __builtin_clz(mask));
+#endif
+	}
+
+	template< std::size_t Size >
+	struct Compare;
+
+	template<>
+	struct Compare<1>
+	{
+		static __m128i broadcast(std::uint32_t value) { return _mm_set1_epi8(static_cast<char>(value)); }
+		static __m128i equal(__m128i left, __m128i right) { return _mm_cmpeq_epi8(left, right); }
+#if defined(VECTOR_SEARCH_AVX2)
+		static __m256i broadcastWide(std::uint32_t value) { return _mm256_set1_epi8(static_cast<char>(value)); }
+		static __m256i equal(__m256i left, __m256i right) { return _mm256_cmpeq_epi8(left, right); }
+#endif
+	};
+
+	template<>
+	struct Compare<2>
+	{
+		static __m128i broadcast(std::uint32_t value) { return _mm_set1_epi16(static_cast<short>(value)); }
+		static __m128i equal(__m128i left, __m128i right) { return _mm_cmpeq_epi16(left, right); }
+#if defined(VECTOR_SEARCH_AVX2)
+		static __m256i broadcastWide(std::uint32_t value) { return _mm256_set1_epi16(static_cast<short>(value)); }
+		static __m256i equal(__m256i left, __m256i right) { return _mm256_cmpeq_epi16(left, right); }
+#endif
+	};
+
+	template<>
+	struct Compare<4>
+	{
+		static __m128i broadcast(std::uint32_t value) { return _mm_set1_epi32(static_cast<int>(value)); }
+		static __m128i equal(__m128i left, __m128i right) { return _mm_cmpeq_epi32(left, right); }
+#if defined(VECTOR_SEARCH_AVX2)
+		static __m256i broadcastWide(std::uint32_t value) { return _mm256_set1_epi32(static_cast<int>(value)); }
+		static __m256i equal(__m256i left, __m256i right) { return _mm256_cmpeq_epi32(left, right); }
+#endif
+	};
+}
+
+template< typename Type >
+struct VectorSearch<Type, true>
+{
+private:
+	using Compare = VectorSearchDetail::Compare<sizeof(Type)>;
+
+	static constexpr std::size_t NarrowCount = (16 / sizeof(Type));
+	static constexpr std::size_t WideCount = (32 / sizeof(Type));
+
+	// movemask yields one bit per byte, so each item owns sizeof(Type) bits
+	static std::uint32_t match(const Type * data, __m128i needle)
+	{
+		const __m128i items = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(Compare::equal(items, needle)));
+	}
+
+#if defined(VECTOR_SEARCH_AVX2)
+	static std::uint32_t match(const Type * data, __m256i needle)
+	{
+		const __m256i items = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+		return static_cast<std::uint32_t>(_mm256_movemask_epi8(Compare::equal(items, needle)));
+	}
+#endif
+
+public:
+	// O(N)
+	static std::size_t findFirst(const Type * data, std::size_t count, const Type & value)
+	{
+		std::size_t index = 0;
+
+#if defined(VECTOR_SEARCH_AVX2)
+		const __m256i wideNeedle = Compare::broadcastWide(static_cast<std::uint32_t>(value));
+
+		for (; (index + WideCount) <= count; index += WideCount)
+		{
+			const std::uint32_t mask = match(&data[index], wideNeedle);
+
+			if (mask != 0)
+				return (index + (VectorSearchDetail::getLowestBit(mask) / sizeof(Type)));
+		}
+#endif
+
+		const __m128i needle = Compare::broadcast(static_cast<std::uint32_t>(value));
+
+		for (; (index + NarrowCount) <= count; index += NarrowCount)
+		{
+			const std::uint32_t mask = match(&data[index], needle);
+
+			if (mask != 0)
+				return (index + (VectorSearchDetail::getLowestBit(mask) / sizeof(Type)));
+		}
+
+		for (; index < count; ++index)
+			if (data[index] == value)
+				return index;
+
+		return count;
+	}
+
+	// O(N)
+	static std::size_t findLast(const Type * data, std::size_t count, const Type & value)
+	{
+		std::size_t index = count;
+
+#if defined(VECTOR_SEARCH_AVX2)
+		const __m256i wideNeedle = Compare::broadcastWide(static_cast<std::uint32_t>(value));
+
+		for (; index >= WideCount; index -= WideCount)
+		{
+			const std::uint32_t mask = match(&data[index - WideCount], wideNeedle);
+
+			if (mask != 0)
+				return (index - WideCount + (VectorSearchDetail::getHighestBit(mask) / sizeof(Type)));
+		}
+#endif
+
+		const __m128i needle = Compare::broadcast(static_cast<std::uint32_t>(value));
+
+		for (; index >= NarrowCount; index -= NarrowCount)
+		{
+			const std::uint32_t mask = match(&data[index - NarrowCount], needle);
+
+			if (mask != 0)
+				return (index - NarrowCount + (VectorSearchDetail::getHighestBit(mask) / sizeof(Type)));
+		}
+
+		for (; index > 0; --index)
+			if (data[index - 1] == value)
+				return (index - 1);
+
+		return count;
+	}
+};
+
+template< typename Type >
+using VectorSearchFor = VectorSearch<Type, (std::is_integral<Type>::value && (sizeof(Type) <= 4) && ((sizeof(Type) & (sizeof(Type) - 1)) == 0))>;
+#else
+template< typename Type >
+using VectorSearchFor = VectorSearch<Type>;
+#endif
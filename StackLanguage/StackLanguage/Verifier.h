@@ -0,0 +1,278 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+
+#include "StdInt.h"
+#include "LanguageTypes.h"
+#include "Opcode.h"
+#include "Instruction.h"
+#include "Module.h"
+#include "ResultInfo.h"
+
+// The version of the rules below and of the opcode semantics they assume.
+// Bump it whenever either changes, so that programs verified under the old rules aren't reused
+// (see ProgramCache).
+constexpr std::uint32_t VerifierVersion = 1;
+
+//
+// Checks a module ahead of running it, so that mistakes the processor would only
+// find when it reached them are reported up front.
+//
+// Every instruction must have an opcode the processor executes,
+// every Extend must precede an instruction that can be extended,
+// every Call, JumpAbsolute and JumpRelative with a fixed target must land on an instruction,
+// every PushConstant and CallNative index must be in range,
+// and every PrintInt must name a base the processor prints in.
+// The data section must fit in the memory chosen by Settings.
+//
+// Verification doesn't prove a program is correct, e.g. CallIndirect targets
+// and stack depths depend on what the program does at run time.
+//
+// The code of a lazy module isn't available up front, so verify leaves it
+// to verifyFunction, which the processor runs as each function is materialised.
+//
+
+template< typename Settings >
+class Verifier
+{
+public:
+	using SettingsType = Settings;
+
+	static constexpr std::size_t NativeFunctionListSize = SettingsType::NativeFunctionListSize;
+	static constexpr std::size_t MemorySize = SettingsType::MemorySize;
+
+private:
+	std::size_t errorIndex = 0;
+
+public:
+	ResultInfo verify(const Module & module);
+
+	// Also checks that the function's jumps stay within it and that it can't run off its end
+	ResultInfo verifyFunction(const Module & module, const ModuleFunction & function);
+
+	// The index of the instruction at fault
+	std::size_t getErrorIndex(void) const
+	{
+		return this->errorIndex;
+	}
+
+private:
+	ResultInfo error(std::size_t index, const char * message)
+	{
+		this->errorIndex = index;
+		return resultError(message);
+	}
+
+	// Checks the instructions from begin up to end.
+	// If contained is true, jumps must also land between begin and end.
+	ResultInfo verifyCode(const Module & module, std::size_t begin, std::size_t end, bool contained);
+
+	static bool isExecutable(Opcode opcode);
+	static bool isExtendable(Opcode opcode);
+};
+
+//
+// Definition
+//
+
+template< typename Settings >
+ResultInfo Verifier<Settings>::verify(const Module & module)
+{
+	const auto code = module.getCode();
+	const std::size_t count = code.getCount();
+
+	if (module.getData().getCount() > (MemorySize - Module::DataAddress))
+		return this->error(0, "Module data doesn't fit in memory");
+
+	if ((count == 0) || (module.getEntryPoint() >= count))
+		return this->error(module.getEntryPoint(), "Module entry point out of bounds");
+
+	if (module.isLazy())
+		return resultSuccess();
+
+	return this->verifyCode(module, 0, count, false);
+}
+
+template< typename Settings >
+ResultInfo Verifier<Settings>::verifyFunction(const Module & module, const ModuleFunction & function)
+{
+	const std::size_t first = function.address;
+	const std::size_t last = (first + function.count);
+
+	const auto result = this->verifyCode(module, first, last, true);
+
+	if (result.isError())
+		return result;
+
+	// Whatever follows the function may not be loaded
+	switch (module.getCode()[last - 1].getOpcode())
+	{
+	case Opcode::End:
+	case Opcode::Return:
+	case Opcode::JumpAbsolute:
+	case Opcode::JumpRelative:
+		return resultSuccess();
+
+	default:
+		return this->error(last - 1, "Function can run off its end");
+	}
+}
+
+template< typename Settings >
+ResultInfo Verifier<Settings>::verifyCode(const Module & module, std::size_t begin, std::size_t end, bool contained)
+{
+	const auto code = module.getCode();
+	const std::size_t count = code.getCount();
+
+	// Where jumps may land
+	const std::size_t lowest = contained ? begin : 0;
+	const std::size_t highest = contained ? end : count;
+
+	for (std::size_t index = begin; index < end; ++index)
+	{
+		const Instruction instruction = code[index];
+		const std::size_t first = index;
+
+		Opcode opcode = instruction.getOpcode();
+		Word operand = instruction.getOperand();
+		SWord signedOperand = instruction.getSignedOperand();
+
+		if (opcode == Opcode::Extend)
+		{
+			if (operand > 0xFF)
+				return this->error(index, "Invalid extension");
+
+			if ((index + 1) >= end)
+				return this->error(index, "Extension at the end of the code");
+
+			++index;
+
+			const Instruction extended = code[index];
+
+			opcode = extended.getOpcode();
+			operand = ((operand << 24) | extended.getOperand());
+			signedOperand = static_cast<SWord>(operand);
+
+			if (!isExtendable(opcode))
+				return this->error(first, "Instruction can't be extended");
+		}
+
+		if (!isExecutable(opcode))
+			return this->error(index, "Unrecognised opcode");
+
+		switch (opcode)
+		{
+		case Opcode::Call:
+			if (operand >= count)
+				return this->error(first, "Jump to invalid address");
+			break;
+
+		case Opcode::JumpAbsolute:
+			if ((operand < lowest) || (operand >= highest))
+				return this->error(first, "Jump to invalid address");
+			break;
+
+		case Opcode::JumpRelative:
+		{
+			// Relative to the instruction after
+			const std::int64_t target = (static_cast<std::int64_t>(index) + 1 + signedOperand);
+
+			if ((target < static_cast<std::int64_t>(lowest)) || (target >= static_cast<std::int64_t>(highest)))
+				return this->error(first, "Jump to invalid address");
+			break;
+		}
+
+		case Opcode::PrintInt:
+			if ((operand != 0) && (operand != 2) && (operand != 10) && (operand != 16))
+				return this->error(first, "Invalid number base");
+			break;
+
+		case Opcode::PushConstant:
+			if (operand >= module.getConstants().getCount())
+				return this->error(first, "Invalid constant");
+			break;
+
+		case Opcode::CallNative:
+			if (operand >= NativeFunctionListSize)
+				return this->error(first, "Invalid native function index");
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return resultSuccess();
+}
+
+// The opcodes Processor::execute dispatches
+template< typename Settings >
+bool Verifier<Settings>::isExecutable(Opcode opcode)
+{
+	switch (opcode)
+	{
+	case Opcode::Nop: case Opcode::End: case Opcode::Break: case Opcode::PrintInt: case Opcode::PrintChar:
+	case Opcode::PrintLine: case Opcode::PrintStack: case Opcode::Extend:
+
+	case Opcode::Push: case Opcode::Drop: case Opcode::Pick: case Opcode::Roll: case Opcode::Duplicate:
+	case Opcode::Swap: case Opcode::Rotate: case Opcode::Over: case Opcode::PushConstant:
+
+	case Opcode::Call: case Opcode::CallIndirect: case Opcode::Return: case Opcode::JumpRelative:
+	case Opcode::JumpAbsolute: case Opcode::CallNative:
+
+	case Opcode::Add: case Opcode::AddImmediate: case Opcode::Subtract: case Opcode::SubtractImmediate: case Opcode::Negate:
+
+	case Opcode::And: case Opcode::AndImmediate: case Opcode::Or: case Opcode::OrImmediate: case Opcode::ExclusiveOr:
+	case Opcode::ExclusiveOrImmediate: case Opcode::ShiftLeft: case Opcode::ShiftLeftImmediate: case Opcode::ShiftRight:
+	case Opcode::ShiftRightImmediate: case Opcode::Not:
+
+	case Opcode::BitSet: case Opcode::BitClear: case Opcode::BitToggle:
+
+	case Opcode::LoadByte: case Opcode::LoadWord: case Opcode::StoreByte: case Opcode::StoreWord:
+
+	case Opcode::Malloc: case Opcode::MallocImmediate: case Opcode::Calloc: case Opcode::CallocImmediate:
+	case Opcode::Realloc: case Opcode::ReallocImmediate: case Opcode::Free: case Opcode::ArenaCreate:
+	case Opcode::ArenaAlloc: case Opcode::ArenaReset: case Opcode::ArenaDestroy:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+// The opcodes Processor::executeExtended accepts
+template< typename Settings >
+bool Verifier<Settings>::isExtendable(Opcode opcode)
+{
+	switch (opcode)
+	{
+	case Opcode::Push:
+	case Opcode::Call:
+	case Opcode::JumpRelative:
+	case Opcode::JumpAbsolute:
+	case Opcode::AddImmediate:
+	case Opcode::SubtractImmediate:
+	case Opcode::AndImmediate:
+	case Opcode::OrImmediate:
+	case Opcode::ExclusiveOrImmediate:
+		return true;
+
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+//
+//   Copyright (C) 2018 Pharap (@Pharap)
+//
+//   Licensed under the Apache License, Version 2.0 (the "License");
+//   you may not use this file except in compliance with the License.
+//   You may obtain a copy of the License at
+//
+//        http://www.apache.org/licenses/LICENSE-2.0
+//
+//   Unless required by applicable law or agreed to in writing, software
+//   distributed under the License is distributed on an "AS IS" BASIS,
+//   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+//   See the License for the specific language governing permissions and
+//   limitations under the License.
+//
+
+#include "StdInt.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define VIRTUAL_MEMORY_POSIX
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#include <cstdlib>
+#endif
+
+//
+// Thin wrappers around the platform's page allocator.
+// Pages returned by virtualAllocate and virtualCommit are zeroed.
+//
+
+inline std::size_t virtualPageSize(void)
+{
+#if defined(_WIN32)
+	SYSTEM_INFO information;
+	GetSystemInfo(&information);
+	return information.dwPageSize;
+#elif defined(VIRTUAL_MEMORY_POSIX)
+	return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#else
+	// calloc hands out exactly what was asked for
+	return 1;
+#endif
+}
+
+inline void * virtualAllocate(std::size_t size)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#elif defined(VIRTUAL_MEMORY_POSIX)
+	void * result = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (result != MAP_FAILED) ? result : nullptr;
+#else
+	return std::calloc(size, 1);
+#endif
+}
+
+// Reserves address space without backing it, any access faults until committed.
+// Returns nullptr where reservation isn't supported.
+inline void * virtualReserve(std::size_t size)
+{
+#if defined(_WIN32)
+	return VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#elif defined(VIRTUAL_MEMORY_POSIX)
+	void * result = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	return (result != MAP_FAILED) ? result : nullptr;
+#else
+	(void)size;
+	return nullptr;
+#endif
+}
+
+// Makes part of a reservation readable and writable
+inline bool virtualCommit(void * pointer, std::size_t size)
+{
+#if defined(_WIN32)
+	return (VirtualAlloc(pointer, size, MEM_COMMIT, PAGE_READWRITE) != nullptr);
+#elif defined(VIRTUAL_MEMORY_POSIX)
+	return (mprotect(pointer, size, PROT_READ | PROT_WRITE) == 0);
+#else
+	(void)pointer;
+	(void)size;
+	return false;
+#endif
+}
+
+inline void virtualFree(void * pointer, std::size_t size)
+{
+	if (pointer == nullptr)
+		return;
+
+#if defined(_WIN32)
+	(void)size;
+	VirtualFree(pointer, 0, MEM_RELEASE);
+#elif defined(VIRTUAL_MEMORY_POSIX)
+	munmap(pointer, size);
+#else
+	(void)size;
+	std::free(pointer);
+#endif
+}